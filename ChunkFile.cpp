@@ -0,0 +1,30 @@
+#include "ChunkFile.hpp"
+
+#include <utility>
+
+ChunkFile::ChunkFile(std::string const &filename) : file(filename) {
+	size_t at = 0;
+	while (file.size() - at >= 8) {
+		Chunk chunk;
+		chunk.magic = std::string(file.data() + at, 4);
+		uint32_t size;
+		std::memcpy(&size, file.data() + at + 4, 4);
+		if (size > file.size() - at - 8) {
+			throw std::runtime_error("Chunk '" + chunk.magic + "' in '" + filename + "' runs past end of file");
+		}
+		chunk.data = file.data() + at + 8;
+		chunk.size = size;
+		at += 8 + size;
+		chunk.end = at;
+
+		index.emplace(chunk.magic, uint32_t(chunks.size())); //(keeps the first chunk with each magic)
+		chunks.emplace_back(std::move(chunk));
+	}
+	trailing = file.size() - at;
+}
+
+ChunkFile::Chunk const *ChunkFile::find(std::string_view magic) const {
+	auto f = index.find(std::string(magic));
+	if (f == index.end()) return nullptr;
+	return &chunks[f->second];
+}
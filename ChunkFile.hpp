@@ -0,0 +1,79 @@
+#pragma once
+
+#include "MappedFile.hpp"
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <type_traits>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+
+//A file of chunks (as written by write_chunk in read_write_chunk.hpp), mapped into memory and indexed by magic number:
+// chunks can be viewed in any order and (usually) without copying.
+// note: the constructor will throw if the file can't be mapped or a chunk runs past the end of the file.
+
+struct ChunkFile {
+	ChunkFile(std::string const &filename);
+
+	//each chunk is an 8-byte header (magic, size) followed by 'size' bytes of data:
+	struct Chunk {
+		std::string magic;
+		char const *data = nullptr; //(in the mapping)
+		size_t size = 0;
+		size_t end = 0; //offset of the byte after the chunk in the file
+	};
+
+	//first chunk with a given magic number (nullptr if there isn't one):
+	Chunk const *find(std::string_view magic) const;
+
+	//view a chunk's data as an array of T:
+	// note: will throw if the chunk's size isn't a multiple of sizeof(T).
+	// chunk data is only aligned for T if the sizes of earlier chunks happen to be multiples of its alignment;
+	//  if it isn't, the data is copied into 'unaligned' (or, if 'unaligned' is null, an exception is thrown)
+	template< typename T >
+	std::span< T const > view(Chunk const &chunk, std::vector< T > *unaligned = nullptr) const;
+
+	//view the first chunk with a given magic number:
+	// note: will throw if there is no such chunk.
+	template< typename T >
+	std::span< T const > view(std::string_view magic, std::vector< T > *unaligned = nullptr) const;
+
+	MappedFile file;
+
+	std::vector< Chunk > chunks; //in file order
+	size_t trailing = 0; //bytes after the last chunk that are too few to be a chunk header
+
+	//-- internals --
+	std::unordered_map< std::string, uint32_t > index; //magic -> first chunk with that magic
+};
+
+template< typename T >
+std::span< T const > ChunkFile::view(Chunk const &chunk, std::vector< T > *unaligned) const {
+	static_assert(std::is_trivially_copyable_v< T >, "chunk data can only be viewed as trivially copyable types");
+	if (chunk.size % sizeof(T) != 0) {
+		throw std::runtime_error("Size of chunk '" + chunk.magic + "' in '" + file.filename + "' not divisible by element size");
+	}
+	size_t count = chunk.size / sizeof(T);
+	if (reinterpret_cast< uintptr_t >(chunk.data) % alignof(T) == 0) {
+		return std::span< T const >(reinterpret_cast< T const * >(chunk.data), count);
+	}
+	if (!unaligned) {
+		throw std::runtime_error("Data of chunk '" + chunk.magic + "' in '" + file.filename + "' is not aligned for its element type");
+	}
+	unaligned->resize(count);
+	if (count != 0) std::memcpy(unaligned->data(), chunk.data, chunk.size);
+	return std::span< T const >(unaligned->data(), count);
+}
+
+template< typename T >
+std::span< T const > ChunkFile::view(std::string_view magic, std::vector< T > *unaligned) const {
+	Chunk const *chunk = find(magic);
+	if (!chunk) {
+		throw std::runtime_error("Expected '" + std::string(magic) + "' chunk in '" + file.filename + "'");
+	}
+	return view< T >(*chunk, unaligned);
+}
@@ -0,0 +1,210 @@
+#include "GeometryArena.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+#include <cassert>
+
+//smallest capacity (in vertices or bytes) an arena grows to:
+static constexpr uint32_t MinCapacity = 65536;
+
+uint32_t GeometryArena::Ranges::allocate(uint32_t count) {
+	assert(count > 0);
+	for (auto f = free.begin(); f != free.end(); ++f) {
+		if (f->second < count) continue;
+		uint32_t first = f->first;
+		uint32_t remaining = f->second - count;
+		free.erase(f);
+		if (remaining != 0) free.emplace(first + count, remaining);
+		return first;
+	}
+
+	//nothing large enough; grow (at least doubling, so a series of allocations doesn't grow every time):
+	uint32_t old_capacity = capacity;
+	capacity = std::max(old_capacity + count, std::max(2 * old_capacity, MinCapacity));
+	release(old_capacity, capacity - old_capacity);
+	//(the new space was merged with any free range at the old end, so is the only range large enough)
+	return allocate(count);
+}
+
+void GeometryArena::Ranges::release(uint32_t first, uint32_t count) {
+	if (count == 0) return;
+	assert(first + count <= capacity);
+
+	auto next = free.lower_bound(first);
+	assert((next == free.end() || first + count <= next->first) && "range being released isn't in use");
+	if (next != free.end() && first + count == next->first) {
+		count += next->second;
+		next = free.erase(next);
+	}
+	if (next != free.begin()) {
+		auto prev = std::prev(next);
+		assert(prev->first + prev->second <= first && "range being released isn't in use");
+		if (prev->first + prev->second == first) {
+			prev->second += count;
+			return;
+		}
+	}
+	free.emplace_hint(next, first, count);
+}
+
+//re-allocate a buffer with a new size, keeping the first 'old_size' bytes:
+static void grow_buffer(GLuint *buffer, size_t old_size, size_t new_size) {
+	GLuint grown = 0;
+	glGenBuffers(1, &grown);
+	//(copy targets, since the element array binding belongs to whatever vao is bound)
+	glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+	glBufferData(GL_COPY_WRITE_BUFFER, new_size, nullptr, GL_STATIC_DRAW);
+	if (*buffer != 0) {
+		glBindBuffer(GL_COPY_READ_BUFFER, *buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_size);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffers(1, buffer);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	*buffer = grown;
+}
+
+static void upload(GLuint buffer, size_t offset, size_t size, void const *data) {
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+GeometryArena::GeometryArena(GLsizei stride_, std::vector< Attrib > const &attribs_) : stride(stride_), attribs(attribs_) {
+}
+
+GeometryArena::~GeometryArena() {
+	for (auto const &[locations, vao] : vaos) {
+		glDeleteVertexArrays(1, &vao);
+	}
+	if (vertex_buffer != 0) glDeleteBuffers(1, &vertex_buffer);
+	if (index_buffer != 0) glDeleteBuffers(1, &index_buffer);
+}
+
+uint32_t GeometryArena::allocate_vertices(uint32_t count, void const *data) {
+	if (count == 0) return 0;
+	uint32_t old_capacity = vertices.capacity;
+	uint32_t first = vertices.allocate(count);
+	if (vertices.capacity != old_capacity) {
+		grow_buffer(&vertex_buffer, size_t(old_capacity) * stride, size_t(vertices.capacity) * stride);
+		for (auto const &[locations, vao] : vaos) {
+			bind_vao(vao, locations);
+		}
+	}
+	upload(vertex_buffer, size_t(first) * stride, size_t(count) * stride, data);
+	return first;
+}
+
+void GeometryArena::free_vertices(uint32_t first, uint32_t count) {
+	vertices.release(first, count);
+}
+
+uint32_t GeometryArena::allocate_indices(uint32_t bytes, void const *data) {
+	if (bytes == 0) return 0;
+	uint32_t old_capacity = indices.capacity;
+	//(ranges are rounded up to multiples of four, so every range starts four-byte aligned)
+	uint32_t offset = indices.allocate((bytes + 3) & ~3U);
+	if (indices.capacity != old_capacity) {
+		grow_buffer(&index_buffer, old_capacity, indices.capacity);
+		for (auto const &[locations, vao] : vaos) {
+			bind_vao(vao, locations);
+		}
+	}
+	upload(index_buffer, offset, bytes, data);
+	return offset;
+}
+
+void GeometryArena::free_indices(uint32_t offset, uint32_t bytes) {
+	indices.release(offset, (bytes + 3) & ~3U);
+}
+
+//active attributes (name and location) of a program:
+// (queried fresh each call -- GL may re-use a deleted program's name, so caching by name isn't safe)
+static std::vector< std::pair< std::string, GLint > > active_attribs(GLuint program) {
+	std::vector< std::pair< std::string, GLint > > active;
+	GLint count = 0;
+	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+	assert(count >= 0 && "Doesn't makes sense to have negative active attributes.");
+	for (GLuint i = 0; i < GLuint(count); ++i) {
+		GLchar name[100];
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveAttrib(program, i, 100, NULL, &size, &type, name);
+		name[99] = '\0';
+		active.emplace_back(name, glGetAttribLocation(program, name));
+	}
+	return active;
+}
+
+GLuint GeometryArena::make_vao_for_program(GLuint program, bool instanced) {
+	std::vector< std::pair< std::string, GLint > > active = active_attribs(program);
+	auto location_of = [&](std::string const &name) -> GLint {
+		for (auto const &[active_name, location] : active) {
+			if (active_name == name) return location;
+		}
+		return -1;
+	};
+
+	//the locations this program wants each attribute at (then the per-instance attribute):
+	std::vector< GLint > locations;
+	locations.reserve(attribs.size() + 1);
+	for (Attrib const &attrib : attribs) {
+		locations.emplace_back(location_of(attrib.name));
+	}
+	locations.emplace_back(instanced ? location_of("WORLD_FROM_OBJECT") : -1);
+
+	//Check that all active attributes will be bound:
+	for (auto const &[name, location] : active) {
+		bool bound = std::find(locations.begin(), locations.end() - 1, location) != locations.end() - 1;
+		//WORLD_FROM_OBJECT is a mat4x3, which occupies one location per column:
+		GLint instance = locations.back();
+		if (instance != -1 && instance <= location && location < instance + 4) bound = true;
+		if (location == -1 || !bound) {
+			throw std::runtime_error("ERROR: active attribute '" + name + "' in program is not bound.");
+		}
+	}
+
+	//re-use a vao with the same bindings, if there is one:
+	for (auto const &[cached_locations, cached_vao] : vaos) {
+		if (cached_locations == locations) return cached_vao;
+	}
+
+	GLuint vao = 0;
+	glGenVertexArrays(1, &vao);
+	bind_vao(vao, locations);
+	vaos.emplace_back(locations, vao);
+	return vao;
+}
+
+void GeometryArena::bind_vao(GLuint vao, std::vector< GLint > const &locations) const {
+	assert(locations.size() == attribs.size() + 1);
+	glBindVertexArray(vao);
+
+	//(attributes are only pointed at the buffer once it exists; allocate_vertices will call this again when it does)
+	if (vertex_buffer != 0) {
+		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+		for (uint32_t i = 0; i < attribs.size(); ++i) {
+			if (locations[i] == -1) continue;
+			Attrib const &attrib = attribs[i];
+			glVertexAttribPointer(locations[i], attrib.size, attrib.type, attrib.normalized, stride, (GLbyte *)0 + attrib.offset);
+			glEnableVertexAttribArray(locations[i]);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	//the element array binding is part of the vao's state:
+	if (index_buffer != 0) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+	}
+
+	//per-instance attribute (pointer will be set at draw time):
+	if (GLint instance = locations.back(); instance != -1) {
+		for (GLuint c = 0; c < 4; ++c) {
+			glEnableVertexAttribArray(instance + c);
+			glVertexAttribDivisor(instance + c, 1);
+		}
+	}
+
+	glBindVertexArray(0);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+/*
+ * A GeometryArena holds the vertex and index data of many MeshBuffers (all
+ *  with the same vertex format) in one pair of OpenGL buffers, so meshes
+ *  loaded from different files can share vertex array objects and be drawn
+ *  without re-binding anything between them.
+ * Ranges are handed out first-fit from a free list and can be freed again
+ *  (e.g., when a level is unloaded); the buffers grow as needed, and vaos
+ *  made by the arena are re-pointed at the new buffers when they do.
+ *
+ */
+
+#include "GL.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+struct GeometryArena {
+	//one vertex attribute (in exactly the format wanted by glVertexAttribPointer):
+	struct Attrib {
+		std::string name; //attribute name in programs
+		GLint size = 0;
+		GLenum type = 0;
+		GLboolean normalized = GL_FALSE;
+		GLsizei offset = 0;
+	};
+
+	//make an (empty) arena for vertices of 'stride' bytes containing 'attribs':
+	// note: GL buffers aren't allocated until something is stored
+	GeometryArena(GLsizei stride, std::vector< Attrib > const &attribs);
+	~GeometryArena();
+
+	//(vaos and ranges refer to the arena, so it can't be copied)
+	GeometryArena(GeometryArena const &) = delete;
+	GeometryArena &operator=(GeometryArena const &) = delete;
+
+	GLsizei const stride;
+	std::vector< Attrib > const attribs;
+
+	//store 'count' vertices (stride bytes each) from 'data'; returns the index of the first vertex:
+	uint32_t allocate_vertices(uint32_t count, void const *data);
+	void free_vertices(uint32_t first, uint32_t count);
+
+	//store 'bytes' bytes of index data; returns the byte offset of the first index:
+	// (offsets are multiples of four, so any index type can be stored)
+	uint32_t allocate_indices(uint32_t bytes, void const *data);
+	void free_indices(uint32_t offset, uint32_t bytes);
+
+	//get a vertex array object that links the arena's buffers to attributes of a program:
+	// if 'instanced', the (mat4x3) WORLD_FROM_OBJECT attribute is set up with a divisor of one but not bound to any buffer
+	// note: will throw if program has active attributes that aren't in the vertex format
+	// vaos belong to the arena and are shared between programs that use the same attribute locations
+	GLuint make_vao_for_program(GLuint program, bool instanced);
+
+	//-- internals ---
+
+	//first-fit allocation of ranges of [0,capacity):
+	struct Ranges {
+		uint32_t capacity = 0;
+		std::map< uint32_t, uint32_t > free; //first -> count of each free range (never adjacent)
+		//returns first of the allocated range; grows capacity if no free range is large enough:
+		uint32_t allocate(uint32_t count);
+		void release(uint32_t first, uint32_t count);
+	};
+
+	Ranges vertices; //in vertices
+	Ranges indices; //in bytes
+
+	GLuint vertex_buffer = 0;
+	GLuint index_buffer = 0;
+
+	//vaos made by make_vao_for_program, keyed by the location of each attribute (-1 if not bound), then WORLD_FROM_OBJECT:
+	std::vector< std::pair< std::vector< GLint >, GLuint > > vaos;
+
+	//point a vao's attributes (per 'locations') at the current buffers:
+	void bind_vao(GLuint vao, std::vector< GLint > const &locations) const;
+};
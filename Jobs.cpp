@@ -0,0 +1,137 @@
+#include "Jobs.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+//set on worker threads (and on the caller while running a parallel_for) so nested calls run serially:
+thread_local bool in_job = false;
+
+struct Pool {
+	Pool() {
+		uint32_t hardware = std::thread::hardware_concurrency();
+		uint32_t workers = (hardware > 1 ? hardware - 1 : 0);
+		threads.reserve(workers);
+		for (uint32_t i = 0; i < workers; ++i) {
+			threads.emplace_back([this](){ worker(); });
+		}
+	}
+	~Pool() {
+		{
+			std::unique_lock< std::mutex > lock(mutex);
+			quit = true;
+		}
+		wake.notify_all();
+		for (auto &thread : threads) {
+			thread.join();
+		}
+	}
+
+	//current job (only one parallel_for runs at a time; guarded by 'submit'):
+	std::mutex submit;
+	std::function< void(uint32_t, uint32_t) > const *fn = nullptr;
+	uint32_t count = 0;
+	uint32_t grain = 1;
+	uint32_t helpers = 0; //how many workers should join in on the current job
+	std::atomic< uint32_t > next{0}; //start of next unclaimed range
+
+	//worker wakeup:
+	std::mutex mutex;
+	std::condition_variable wake; //signalled when a new job is posted (or on quit)
+	std::condition_variable finished; //signalled when a worker stops working on a job
+	uint64_t generation = 0; //incremented for each job
+	uint32_t joined = 0; //workers that have started on the current generation
+	uint32_t active = 0; //workers currently running ranges
+	bool quit = false;
+
+	std::vector< std::thread > threads;
+
+	//claim and run ranges until the job is exhausted:
+	void run_ranges() {
+		while (true) {
+			uint32_t begin = next.fetch_add(grain);
+			if (begin >= count) break;
+			uint32_t end = std::min(count, begin + grain);
+			(*fn)(begin, end);
+		}
+	}
+
+	void worker() {
+		in_job = true;
+		uint64_t seen = 0;
+		while (true) {
+			{
+				std::unique_lock< std::mutex > lock(mutex);
+				wake.wait(lock, [&](){ return quit || (generation != seen && joined < helpers); });
+				if (quit) return;
+				seen = generation;
+				joined += 1;
+				active += 1;
+			}
+			run_ranges();
+			{
+				std::unique_lock< std::mutex > lock(mutex);
+				active -= 1;
+			}
+			finished.notify_all();
+		}
+	}
+};
+
+Pool &pool() {
+	static Pool pool;
+	return pool;
+}
+
+} //anonymous namespace
+
+uint32_t Jobs::thread_count() {
+	return uint32_t(pool().threads.size()) + 1;
+}
+
+void Jobs::parallel_for(uint32_t count, uint32_t grain, std::function< void(uint32_t, uint32_t) > const &fn, uint32_t threads) {
+	grain = std::max(grain, 1U);
+
+	//serial fallback:
+	if (threads <= 1 || count <= grain || in_job) {
+		for (uint32_t begin = 0; begin < count; begin += grain) {
+			fn(begin, std::min(count, begin + grain));
+		}
+		return;
+	}
+
+	Pool &p = pool();
+	std::unique_lock< std::mutex > submit_lock(p.submit);
+
+	uint32_t ranges = (count + grain - 1) / grain;
+	uint32_t helpers = std::min({ threads - 1, uint32_t(p.threads.size()), ranges - 1 });
+
+	{ //post job:
+		std::unique_lock< std::mutex > lock(p.mutex);
+		p.fn = &fn;
+		p.count = count;
+		p.grain = grain;
+		p.helpers = helpers;
+		p.next = 0;
+		p.joined = 0;
+		p.generation += 1;
+	}
+	if (helpers > 0) p.wake.notify_all();
+
+	//help out:
+	in_job = true;
+	p.run_ranges();
+	in_job = false;
+
+	{ //all ranges are claimed; wait for workers to finish the ones they are running:
+		std::unique_lock< std::mutex > lock(p.mutex);
+		//(also stops any late-waking workers from joining this job)
+		p.helpers = 0;
+		p.finished.wait(lock, [&](){ return p.active == 0; });
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+//Minimal job system: a pool of persistent worker threads that can split a loop across cores.
+// Workers are started on first use and joined at exit.
+
+namespace Jobs {
+
+//number of threads that can run a parallel_for (worker threads plus the calling thread):
+uint32_t thread_count();
+
+//call fn(begin, end) over sub-ranges covering [0, count), using up to 'threads' threads (including the caller):
+// - ranges are at least 'grain' items long (except possibly the last one)
+// - returns once every range has been processed
+// - runs serially (on the calling thread, in order) if threads <= 1, count <= grain, or if called from inside a job
+// - fn must not throw
+void parallel_for(uint32_t count, uint32_t grain, std::function< void(uint32_t, uint32_t) > const &fn, uint32_t threads = -1U);
+
+} //namespace Jobs
@@ -0,0 +1,121 @@
+#include "LightClusters.hpp"
+
+#include "Jobs.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+glm::vec4 LightClusters::cell_scale(glm::uvec2 const &viewport_size) const {
+	float z_scale = float(dims.z) / std::log(far / near);
+	return glm::vec4(
+		float(dims.x) / float(std::max(1U, viewport_size.x)),
+		float(dims.y) / float(std::max(1U, viewport_size.y)),
+		z_scale,
+		-std::log(near) * z_scale
+	);
+}
+
+void LightClusters::build(glm::mat4 const &clip_from_world, std::vector< glm::vec4 > const &spheres, uint32_t threads) {
+	uint32_t light_count = uint32_t(spheres.size());
+	uint32_t cell_count = dims.x * dims.y * dims.z;
+
+	//--- find range of cells covered by each light ---
+	indices.clear();
+	ranges.assign(light_count, Range());
+
+	for (uint32_t l = 0; l < light_count; ++l) {
+		if (spheres[l].w == std::numeric_limits< float >::infinity()) {
+			indices.emplace_back(l);
+		}
+	}
+	global_count = uint32_t(indices.size());
+
+	float z_scale = float(dims.z) / std::log(far / near);
+	auto slice = [&](float w) {
+		if (!(w > near)) return 0U; //(also catches NaN)
+		return std::min(dims.z - 1, uint32_t(std::log(w / near) * z_scale));
+	};
+
+	glm::vec4 row_w = glm::vec4(clip_from_world[0][3], clip_from_world[1][3], clip_from_world[2][3], clip_from_world[3][3]);
+
+	Jobs::parallel_for(light_count, 64, [&](uint32_t begin, uint32_t end){
+		for (uint32_t l = begin; l < end; ++l) {
+			glm::vec3 center = glm::vec3(spheres[l]);
+			float radius = spheres[l].w;
+			if (radius == std::numeric_limits< float >::infinity()) continue;
+
+			Range &range = ranges[l];
+
+			//clip w is linear, so the range of w over the sphere is exact:
+			float w = glm::dot(row_w, glm::vec4(center, 1.0f));
+			float w_radius = glm::length(glm::vec3(row_w)) * radius;
+			if (w + w_radius < 0.0f) continue; //entirely behind the camera
+			range.min.z = slice(w - w_radius);
+			range.max.z = slice(w + w_radius);
+
+			//screen extents come from projecting the corners of the sphere's bounding box:
+			glm::vec2 ndc_min = glm::vec2( std::numeric_limits< float >::infinity());
+			glm::vec2 ndc_max = glm::vec2(-std::numeric_limits< float >::infinity());
+			bool crosses_eye = false;
+			for (uint32_t c = 0; c < 8; ++c) {
+				glm::vec3 corner = center + radius * glm::vec3((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 4) ? 1.0f : -1.0f);
+				glm::vec4 clip = clip_from_world * glm::vec4(corner, 1.0f);
+				if (clip.w <= 1e-6f) {
+					//box crosses the eye plane, so its projection is unbounded:
+					crosses_eye = true;
+					break;
+				}
+				glm::vec2 ndc = glm::vec2(clip) / clip.w;
+				ndc_min = glm::min(ndc_min, ndc);
+				ndc_max = glm::max(ndc_max, ndc);
+			}
+			if (crosses_eye) {
+				ndc_min = glm::vec2(-1.0f);
+				ndc_max = glm::vec2(1.0f);
+			}
+			if (ndc_max.x < -1.0f || ndc_min.x > 1.0f || ndc_max.y < -1.0f || ndc_min.y > 1.0f) continue; //off screen
+
+			auto tile = [](float ndc, uint32_t count) {
+				float t = (ndc * 0.5f + 0.5f) * float(count);
+				return uint32_t(std::clamp(t, 0.0f, float(count - 1)));
+			};
+			range.min.x = tile(ndc_min.x, dims.x);
+			range.max.x = tile(ndc_max.x, dims.x);
+			range.min.y = tile(ndc_min.y, dims.y);
+			range.max.y = tile(ndc_max.y, dims.y);
+			range.any = true;
+		}
+	}, threads);
+
+	//--- fill cells, one depth slice per job (slices don't share cells, so no synchronization is needed) ---
+	cell_scratch.resize(size_t(cell_count) * max_cell_lights);
+	cell_counts.assign(cell_count, 0);
+
+	Jobs::parallel_for(dims.z, 1, [&](uint32_t begin, uint32_t end){
+		for (uint32_t z = begin; z < end; ++z) {
+			for (uint32_t l = 0; l < light_count; ++l) {
+				Range const &range = ranges[l];
+				if (!range.any || z < range.min.z || z > range.max.z) continue;
+				for (uint32_t y = range.min.y; y <= range.max.y; ++y) {
+					for (uint32_t x = range.min.x; x <= range.max.x; ++x) {
+						uint32_t cell = (z * dims.y + y) * dims.x + x;
+						uint32_t &count = cell_counts[cell];
+						if (count < max_cell_lights) {
+							cell_scratch[size_t(cell) * max_cell_lights + count] = l;
+							count += 1;
+						}
+					}
+				}
+			}
+		}
+	}, threads);
+
+	//--- compact lists (in cell order, so results don't depend on thread count) ---
+	cells.resize(cell_count);
+	for (uint32_t cell = 0; cell < cell_count; ++cell) {
+		cells[cell] = glm::uvec2(uint32_t(indices.size()), cell_counts[cell]);
+		uint32_t const *list = cell_scratch.data() + size_t(cell) * max_cell_lights;
+		indices.insert(indices.end(), list, list + cell_counts[cell]);
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+/*
+ * LightClusters assigns lights to the cells of a view-space grid
+ *  (screen tiles x logarithmic depth slices) so that shaders only
+ *  need to evaluate the lights that can reach each fragment's cell.
+ *
+ * Used by Scene::draw for programs with clustered lighting; kept separate
+ *  from Scene (and from OpenGL) so it can be tested and timed on its own.
+ *
+ */
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct LightClusters {
+	//grid size (tiles across, tiles down, depth slices):
+	glm::uvec3 dims = glm::uvec3(16, 9, 24);
+	//depth slices are spaced logarithmically in clip w (== view distance, for perspective projections) over this range:
+	// (things nearer or farther land in the first or last slice)
+	float near = 0.05f;
+	float far = 500.0f;
+	//lights beyond this many in a cell are dropped:
+	uint32_t max_cell_lights = 128;
+
+	//assign lights to cells:
+	// spheres are world-space (center, radius); lights with an infinite radius reach every cell and are listed in 'globals'
+	// cells are split across up to 'threads' threads (see Jobs.hpp)
+	void build(glm::mat4 const &clip_from_world, std::vector< glm::vec4 > const &spheres, uint32_t threads = -1U);
+
+	//-- results --
+	//indices of lights: first the global lights (indices[0, global_count)), then each cell's list:
+	std::vector< uint32_t > indices;
+	uint32_t global_count = 0;
+	//per cell (x fastest, then y, then z): (offset into indices, count):
+	std::vector< glm::uvec2 > cells;
+
+	//parameters shaders need to find a fragment's cell:
+	// cell.xy = (gl_FragCoord.xy - viewport origin) * scale.xy, cell.z = log(clip w) * scale.z + scale.w
+	glm::vec4 cell_scale(glm::uvec2 const &viewport_size) const;
+
+	//-- internals --
+	//per-light ranges of cells covered (inclusive), computed by build():
+	struct Range {
+		glm::uvec3 min, max;
+		bool any = false;
+	};
+	std::vector< Range > ranges;
+	std::vector< uint32_t > cell_scratch; //max_cell_lights entries per cell
+	std::vector< uint32_t > cell_counts;
+};
@@ -4,55 +4,166 @@
 #include "gl_errors.hpp"
 
 Scene::Drawable::Pipeline lit_color_texture_program_pipeline;
+Scene::Drawable::Pipeline lit_color_texture_program_object_block_pipeline;
+Scene::Drawable::Pipeline lit_color_texture_program_clustered_pipeline;
+Scene::Drawable::Pipeline lit_color_texture_program_quantized_pipeline;
+
+//fill in the parts of a pipeline template that every variant shares:
+// (the 1-pixel white default texture is made once and shared by all templates)
+static void init_pipeline(Scene::Drawable::Pipeline *pipeline, LitColorTextureProgram const &program) {
+	static GLuint white_tex = 0;
+	if (white_tex == 0) {
+		//make a 1-pixel white texture to bind by default:
+		glGenTextures(1, &white_tex);
+
+		glBindTexture(GL_TEXTURE_2D, white_tex);
+		std::vector< glm::u8vec4 > tex_data(1, glm::u8vec4(0xff));
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, tex_data.data());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	pipeline->program = program.program;
+
+	pipeline->CLIP_FROM_OBJECT_mat4 = program.CLIP_FROM_OBJECT_mat4;
+	pipeline->LIGHT_FROM_OBJECT_mat4x3 = program.LIGHT_FROM_OBJECT_mat4x3;
+	pipeline->LIGHT_FROM_NORMAL_mat3 = program.LIGHT_FROM_NORMAL_mat3;
+
+	pipeline->OBJECT_LIGHT_COUNT_int = program.OBJECT_LIGHT_COUNT_int;
+	pipeline->OBJECT_LIGHTS_int_array = program.OBJECT_LIGHTS_int_array;
+
+	pipeline->textures[0].texture = white_tex;
+	pipeline->textures[0].target = GL_TEXTURE_2D;
+}
+
+//fill in a pipeline template's instanced variant:
+static void init_instanced(Scene::Drawable::Pipeline *pipeline, LitColorTextureProgram const &program) {
+	pipeline->instanced.program = program.program;
+	pipeline->instanced.WORLD_FROM_OBJECT_mat4x3 = program.WORLD_FROM_OBJECT_mat4x3;
+	pipeline->instanced.CLIP_FROM_WORLD_mat4 = program.CLIP_FROM_WORLD_mat4;
+	pipeline->instanced.LIGHT_FROM_WORLD_mat4x3 = program.LIGHT_FROM_WORLD_mat4x3;
+	pipeline->instanced.OBJECT_LIGHT_COUNT_int = program.OBJECT_LIGHT_COUNT_int;
+	pipeline->instanced.OBJECT_LIGHTS_int_array = program.OBJECT_LIGHTS_int_array;
+	pipeline->instanced.POSITION_OFFSET_vec3 = program.POSITION_OFFSET_vec3;
+	pipeline->instanced.POSITION_SCALE_vec3 = program.POSITION_SCALE_vec3;
+}
+
+//Only the quantized variants (which the game draws with) are compiled at startup.
+// The rest are compiled on first use; each loader also loads its instanced variant, so the pipeline template is complete once either Load is touched.
 
 Load< LitColorTextureProgram > lit_color_texture_program(LoadTagEarly, []() -> LitColorTextureProgram const * {
 	LitColorTextureProgram *ret = new LitColorTextureProgram();
 
-	//----- build the pipeline template -----
-	lit_color_texture_program_pipeline.program = ret->program;
+	init_pipeline(&lit_color_texture_program_pipeline, *ret);
+	init_instanced(&lit_color_texture_program_pipeline, *lit_color_texture_program_instanced);
 
-	lit_color_texture_program_pipeline.CLIP_FROM_OBJECT_mat4 = ret->CLIP_FROM_OBJECT_mat4;
-	lit_color_texture_program_pipeline.LIGHT_FROM_OBJECT_mat4x3 = ret->LIGHT_FROM_OBJECT_mat4x3;
-	lit_color_texture_program_pipeline.LIGHT_FROM_NORMAL_mat3 = ret->LIGHT_FROM_NORMAL_mat3;
+	return ret;
+}, LoadLazy);
 
-	/* This will be used later if/when we build a light loop into the Scene:
-	lit_color_texture_program_pipeline.LIGHT_TYPE_int = ret->LIGHT_TYPE_int;
-	lit_color_texture_program_pipeline.LIGHT_LOCATION_vec3 = ret->LIGHT_LOCATION_vec3;
-	lit_color_texture_program_pipeline.LIGHT_DIRECTION_vec3 = ret->LIGHT_DIRECTION_vec3;
-	lit_color_texture_program_pipeline.LIGHT_ENERGY_vec3 = ret->LIGHT_ENERGY_vec3;
-	lit_color_texture_program_pipeline.LIGHT_CUTOFF_float = ret->LIGHT_CUTOFF_float;
-	*/
+Load< LitColorTextureProgram > lit_color_texture_program_instanced(LoadTagEarly, []() -> LitColorTextureProgram const * {
+	return new LitColorTextureProgram(LitColorTextureProgram::Instanced);
+}, LoadLazy);
 
-	//make a 1-pixel white texture to bind by default:
-	GLuint tex;
-	glGenTextures(1, &tex);
+Load< LitColorTextureProgram > lit_color_texture_program_object_block(LoadTagEarly, []() -> LitColorTextureProgram const * {
+	LitColorTextureProgram *ret = new LitColorTextureProgram(LitColorTextureProgram::ObjectBlock);
 
-	glBindTexture(GL_TEXTURE_2D, tex);
-	std::vector< glm::u8vec4 > tex_data(1, glm::u8vec4(0xff));
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, tex_data.data());
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	init_pipeline(&lit_color_texture_program_object_block_pipeline, *ret);
+	init_instanced(&lit_color_texture_program_object_block_pipeline, *lit_color_texture_program_instanced);
+	//(matrices come from the ObjectMatrices block instead of the per-object uniforms)
+	lit_color_texture_program_object_block_pipeline.CLIP_FROM_OBJECT_mat4 = -1U;
+	lit_color_texture_program_object_block_pipeline.LIGHT_FROM_OBJECT_mat4x3 = -1U;
+	lit_color_texture_program_object_block_pipeline.LIGHT_FROM_NORMAL_mat3 = -1U;
+	lit_color_texture_program_object_block_pipeline.OBJECT_MATRICES_block = ret->OBJECT_MATRICES_block;
 
+	return ret;
+}, LoadLazy);
+
+//clustered lighting variants:
+Load< LitColorTextureProgram > lit_color_texture_program_clustered(LoadTagEarly, []() -> LitColorTextureProgram const * {
+	LitColorTextureProgram *ret = new LitColorTextureProgram(LitColorTextureProgram::Clustered);
+
+	init_pipeline(&lit_color_texture_program_clustered_pipeline, *ret);
+	init_instanced(&lit_color_texture_program_clustered_pipeline, *lit_color_texture_program_clustered_instanced);
+	lit_color_texture_program_clustered_pipeline.OBJECT_LIGHT_COUNT_int = -1U;
+	lit_color_texture_program_clustered_pipeline.OBJECT_LIGHTS_int_array = -1U;
+	lit_color_texture_program_clustered_pipeline.instanced.OBJECT_LIGHT_COUNT_int = -1U;
+	lit_color_texture_program_clustered_pipeline.instanced.OBJECT_LIGHTS_int_array = -1U;
+	lit_color_texture_program_clustered_pipeline.clustered_lights = true;
+
+	return ret;
+}, LoadLazy);
 
-	lit_color_texture_program_pipeline.textures[0].texture = tex;
-	lit_color_texture_program_pipeline.textures[0].target = GL_TEXTURE_2D;
+Load< LitColorTextureProgram > lit_color_texture_program_clustered_instanced(LoadTagEarly, []() -> LitColorTextureProgram const * {
+	return new LitColorTextureProgram(LitColorTextureProgram::Clustered | LitColorTextureProgram::Instanced);
+}, LoadLazy);
+
+//quantized vertex variants:
+Load< LitColorTextureProgram > lit_color_texture_program_quantized(LoadTagEarly, []() -> LitColorTextureProgram const * {
+	LitColorTextureProgram *ret = new LitColorTextureProgram(LitColorTextureProgram::Quantized);
+
+	init_pipeline(&lit_color_texture_program_quantized_pipeline, *ret);
+	lit_color_texture_program_quantized_pipeline.POSITION_OFFSET_vec3 = ret->POSITION_OFFSET_vec3;
+	lit_color_texture_program_quantized_pipeline.POSITION_SCALE_vec3 = ret->POSITION_SCALE_vec3;
 
 	return ret;
 });
 
-LitColorTextureProgram::LitColorTextureProgram() {
+//n.b. loaded after lit_color_texture_program_quantized (same tag, later in file), so it can fill in the pipeline template's instanced variant:
+Load< LitColorTextureProgram > lit_color_texture_program_quantized_instanced(LoadTagEarly, []() -> LitColorTextureProgram const * {
+	LitColorTextureProgram *ret = new LitColorTextureProgram(LitColorTextureProgram::Quantized | LitColorTextureProgram::Instanced);
+
+	init_instanced(&lit_color_texture_program_quantized_pipeline, *ret);
+
+	return ret;
+});
+
+LitColorTextureProgram::LitColorTextureProgram(uint32_t variant) {
+	//variants are selected by #define's after the #version line:
+	std::string defines;
+	if (variant & Instanced) defines += "#define INSTANCED\n";
+	if (variant & ObjectBlock) defines += "#define OBJECT_BLOCK\n";
+	if (variant & Clustered) defines += "#define CLUSTERED\n";
+	if (variant & Quantized) defines += "#define QUANTIZED\n";
+	defines += "#define MAX_LIGHTS " + std::to_string(Scene::MaxLights) + "\n";
+	defines += "#define MAX_OBJECT_LIGHTS " + std::to_string(Scene::MaxObjectLights) + "\n";
+
 	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
 	program = gl_compile_program(
 		//vertex shader:
 		"#version 330\n"
+		+ defines +
+		"#ifdef INSTANCED\n"
+		"uniform mat4 CLIP_FROM_WORLD;\n"
+		"uniform mat4x3 LIGHT_FROM_WORLD;\n"
+		"in mat4x3 WORLD_FROM_OBJECT;\n"
+		"#elif defined(OBJECT_BLOCK)\n"
+		"layout(std140) uniform ObjectMatrices {\n"
+		"	mat4 CLIP_FROM_OBJECT;\n"
+		"	mat4x3 LIGHT_FROM_OBJECT;\n"
+		"	mat3 LIGHT_FROM_NORMAL;\n"
+		"};\n"
+		"#else\n"
 		"uniform mat4 CLIP_FROM_OBJECT;\n"
 		"uniform mat4x3 LIGHT_FROM_OBJECT;\n"
 		"uniform mat3 LIGHT_FROM_NORMAL;\n"
+		"#endif\n"
+		"#ifdef QUANTIZED\n"
+		"uniform vec3 POSITION_OFFSET;\n"
+		"uniform vec3 POSITION_SCALE;\n"
+		"in vec3 Position; //relative to mesh bounds\n"
+		"in vec2 Normal; //octahedral encoding\n"
+		"vec3 octahedral_decode(vec2 e) {\n"
+		"	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+		"	if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n"
+		"	return normalize(n);\n"
+		"}\n"
+		"#else\n"
 		"in vec4 Position;\n"
 		"in vec3 Normal;\n"
+		"#endif\n"
 		"in vec4 Color;\n"
 		"in vec2 TexCoord;\n"
 		"out vec3 position;\n"
@@ -60,21 +171,62 @@ LitColorTextureProgram::LitColorTextureProgram() {
 		"out vec4 color;\n"
 		"out vec2 texCoord;\n"
 		"void main() {\n"
-		"	gl_Position = CLIP_FROM_OBJECT * Position;\n"
-		"	position = LIGHT_FROM_OBJECT * Position;\n"
-		"	normal = LIGHT_FROM_NORMAL * Normal;\n"
+		"#ifdef INSTANCED\n"
+		"	mat4 world_from_object = mat4(\n"
+		"		vec4(WORLD_FROM_OBJECT[0], 0.0), vec4(WORLD_FROM_OBJECT[1], 0.0),\n"
+		"		vec4(WORLD_FROM_OBJECT[2], 0.0), vec4(WORLD_FROM_OBJECT[3], 1.0)\n"
+		"	);\n"
+		"	mat4 CLIP_FROM_OBJECT = CLIP_FROM_WORLD * world_from_object;\n"
+		"	mat4x3 LIGHT_FROM_OBJECT = LIGHT_FROM_WORLD * world_from_object;\n"
+		"	//normal matrix is the inverse transpose, which is the cofactor matrix divided by the determinant;\n"
+		"	// since normals are re-normalized later only the determinant's sign matters:\n"
+		"	mat3 m = mat3(LIGHT_FROM_OBJECT);\n"
+		"	mat3 cofactor = mat3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1]));\n"
+		"	mat3 LIGHT_FROM_NORMAL = (dot(m[0], cofactor[0]) < 0.0 ? -cofactor : cofactor);\n"
+		"#endif\n"
+		"#ifdef QUANTIZED\n"
+		"	vec4 object_position = vec4(POSITION_OFFSET + POSITION_SCALE * Position, 1.0);\n"
+		"	vec3 object_normal = octahedral_decode(Normal);\n"
+		"#else\n"
+		"	vec4 object_position = Position;\n"
+		"	vec3 object_normal = Normal;\n"
+		"#endif\n"
+		"	gl_Position = CLIP_FROM_OBJECT * object_position;\n"
+		"	position = LIGHT_FROM_OBJECT * object_position;\n"
+		"	normal = LIGHT_FROM_NORMAL * object_normal;\n"
 		"	color = Color;\n"
 		"	texCoord = TexCoord;\n"
 		"}\n"
 	,
 		//fragment shader:
 		"#version 330\n"
+		+ defines +
 		"uniform sampler2D TEX;\n"
-		"uniform int LIGHT_TYPE;\n"
-		"uniform vec3 LIGHT_LOCATION;\n"
-		"uniform vec3 LIGHT_DIRECTION;\n"
-		"uniform vec3 LIGHT_ENERGY;\n"
-		"uniform float LIGHT_CUTOFF;\n"
+		"struct Light {\n"
+		"	vec4 position; //xyz: position, w: type (0: point, 1: hemisphere, 2: spot, 3: directional)\n"
+		"	vec4 direction; //xyz: direction light points, w: spot cutoff (cosine of half-angle)\n"
+		"	vec4 energy; //rgb: energy, a: fade-out distance (0: none)\n"
+		"};\n"
+		"#ifdef CLUSTERED\n"
+		"layout(std140) uniform Clusters {\n"
+		"	uvec4 CLUSTER_DIMS; //xyz: grid size, w: number of global lights\n"
+		"	vec4 CLUSTER_SCALE; //cell = ((gl_FragCoord.xy - CLUSTER_ORIGIN.xy) * CLUSTER_SCALE.xy, log(w) * CLUSTER_SCALE.z + CLUSTER_SCALE.w)\n"
+		"	vec4 CLUSTER_ORIGIN; //xy: window position of the viewport's lower left corner\n"
+		"};\n"
+		"uniform samplerBuffer LIGHT_DATA; //three texels per light\n"
+		"uniform usamplerBuffer CLUSTER_CELLS; //(offset, count) per cell\n"
+		"uniform usamplerBuffer CLUSTER_LIGHTS; //light indices\n"
+		"Light fetch_light(uint index) {\n"
+		"	int i = int(index) * 3;\n"
+		"	return Light(texelFetch(LIGHT_DATA, i), texelFetch(LIGHT_DATA, i+1), texelFetch(LIGHT_DATA, i+2));\n"
+		"}\n"
+		"#else\n"
+		"layout(std140) uniform Lights {\n"
+		"	Light LIGHTS[MAX_LIGHTS];\n"
+		"};\n"
+		"uniform int OBJECT_LIGHT_COUNT;\n"
+		"uniform int OBJECT_LIGHTS[MAX_OBJECT_LIGHTS];\n"
+		"#endif\n"
 		"in vec3 position;\n"
 		"in vec3 normal;\n"
 		"in vec4 color;\n"
@@ -83,28 +235,47 @@ LitColorTextureProgram::LitColorTextureProgram() {
 		"float random(vec2 st) { //from https://thebookofshaders.com/10/\n"
 		"	return fract(sin(dot(st, vec2(12.9898, 78.233)))*43758.5453123);\n"
 		"}\n"
-		"void main() {\n"
-		"	vec3 n = normalize(normal);\n"
-		"	vec3 e;\n"
-		"	if (LIGHT_TYPE == 0) { //point light \n"
-		"		vec3 l = (LIGHT_LOCATION - position);\n"
-		"		float dis2 = dot(l,l);\n"
-		"		l = normalize(l);\n"
-		"		float nl = max(0.0, dot(n, l)) / max(1.0, dis2);\n"
-		"		e = nl * LIGHT_ENERGY;\n"
-		"	} else if (LIGHT_TYPE == 1) { //hemi light \n"
-		"		e = (dot(n,-LIGHT_DIRECTION) * 0.5 + 0.5) * LIGHT_ENERGY;\n"
-		"	} else if (LIGHT_TYPE == 2) { //spot light \n"
-		"		vec3 l = (LIGHT_LOCATION - position);\n"
+		"vec3 light_energy(Light light, vec3 n) {\n"
+		"	int type = int(light.position.w);\n"
+		"	if (type == 0 || type == 2) { //point or spot light \n"
+		"		vec3 l = (light.position.xyz - position);\n"
 		"		float dis2 = dot(l,l);\n"
 		"		l = normalize(l);\n"
 		"		float nl = max(0.0, dot(n, l)) / max(1.0, dis2);\n"
-		"		float c = dot(l,-LIGHT_DIRECTION);\n"
-		"		nl *= smoothstep(LIGHT_CUTOFF,mix(LIGHT_CUTOFF,1.0,0.1), c);\n"
-		"		e = nl * LIGHT_ENERGY;\n"
-		"	} else { //(LIGHT_TYPE == 3) //directional light \n"
-		"		e = max(0.0, dot(n,-LIGHT_DIRECTION)) * LIGHT_ENERGY;\n"
+		"		if (type == 2) {\n"
+		"			float c = dot(l,-light.direction.xyz);\n"
+		"			nl *= smoothstep(light.direction.w,mix(light.direction.w,1.0,0.1), c);\n"
+		"		}\n"
+		"		if (light.energy.a > 0.0) { //fade out smoothly by the light's distance, so culled lights don't pop \n"
+		"			float r2 = light.energy.a * light.energy.a;\n"
+		"			float f = clamp(1.0 - (dis2 * dis2) / (r2 * r2), 0.0, 1.0);\n"
+		"			nl *= f * f;\n"
+		"		}\n"
+		"		return nl * light.energy.rgb;\n"
+		"	} else if (type == 1) { //hemi light \n"
+		"		return (dot(n,-light.direction.xyz) * 0.5 + 0.5) * light.energy.rgb;\n"
+		"	} else { //(type == 3) //directional light \n"
+		"		return max(0.0, dot(n,-light.direction.xyz)) * light.energy.rgb;\n"
+		"	}\n"
+		"}\n"
+		"void main() {\n"
+		"	vec3 n = normalize(normal);\n"
+		"	vec3 e = vec3(0.0);\n"
+		"#ifdef CLUSTERED\n"
+		"	for (uint i = 0u; i < CLUSTER_DIMS.w; ++i) {\n"
+		"		e += light_energy(fetch_light(texelFetch(CLUSTER_LIGHTS, int(i)).r), n);\n"
+		"	}\n"
+		"	vec3 cell_f = vec3((gl_FragCoord.xy - CLUSTER_ORIGIN.xy) * CLUSTER_SCALE.xy, log(1.0 / gl_FragCoord.w) * CLUSTER_SCALE.z + CLUSTER_SCALE.w);\n"
+		"	uvec3 cell = uvec3(clamp(cell_f, vec3(0.0), vec3(CLUSTER_DIMS.xyz) - 1.0));\n"
+		"	uvec2 range = texelFetch(CLUSTER_CELLS, int((cell.z * CLUSTER_DIMS.y + cell.y) * CLUSTER_DIMS.x + cell.x)).rg;\n"
+		"	for (uint i = 0u; i < range.y; ++i) {\n"
+		"		e += light_energy(fetch_light(texelFetch(CLUSTER_LIGHTS, int(range.x + i)).r), n);\n"
+		"	}\n"
+		"#else\n"
+		"	for (int i = 0; i < OBJECT_LIGHT_COUNT; ++i) {\n"
+		"		e += light_energy(LIGHTS[OBJECT_LIGHTS[i]], n);\n"
 		"	}\n"
+		"#endif\n"
 		"	vec4 albedo = texture(TEX, texCoord) * color;\n"
 		"	fragColor = vec4(e*albedo.rgb, albedo.a);\n"
 		/* DEBUG: check color output linearity:
@@ -130,17 +301,29 @@ LitColorTextureProgram::LitColorTextureProgram() {
 	Normal_vec3 = glGetAttribLocation(program, "Normal");
 	Color_vec4 = glGetAttribLocation(program, "Color");
 	TexCoord_vec2 = glGetAttribLocation(program, "TexCoord");
+	WORLD_FROM_OBJECT_mat4x3 = glGetAttribLocation(program, "WORLD_FROM_OBJECT");
 
 	//look up the locations of uniforms:
 	CLIP_FROM_OBJECT_mat4 = glGetUniformLocation(program, "CLIP_FROM_OBJECT");
 	LIGHT_FROM_OBJECT_mat4x3 = glGetUniformLocation(program, "LIGHT_FROM_OBJECT");
 	LIGHT_FROM_NORMAL_mat3 = glGetUniformLocation(program, "LIGHT_FROM_NORMAL");
+	CLIP_FROM_WORLD_mat4 = glGetUniformLocation(program, "CLIP_FROM_WORLD");
+	LIGHT_FROM_WORLD_mat4x3 = glGetUniformLocation(program, "LIGHT_FROM_WORLD");
+	POSITION_OFFSET_vec3 = glGetUniformLocation(program, "POSITION_OFFSET");
+	POSITION_SCALE_vec3 = glGetUniformLocation(program, "POSITION_SCALE");
 
-	LIGHT_TYPE_int = glGetUniformLocation(program, "LIGHT_TYPE");
-	LIGHT_LOCATION_vec3 = glGetUniformLocation(program, "LIGHT_LOCATION");
-	LIGHT_DIRECTION_vec3 = glGetUniformLocation(program, "LIGHT_DIRECTION");
-	LIGHT_ENERGY_vec3 = glGetUniformLocation(program, "LIGHT_ENERGY");
-	LIGHT_CUTOFF_float = glGetUniformLocation(program, "LIGHT_CUTOFF");
+	//look up the uniform blocks and attach them to the binding points Scene::draw uses:
+	OBJECT_MATRICES_block = glGetUniformBlockIndex(program, "ObjectMatrices"); //(GL_INVALID_INDEX is -1U)
+	if (OBJECT_MATRICES_block != -1U) {
+		glUniformBlockBinding(program, OBJECT_MATRICES_block, Scene::ObjectMatricesBinding);
+	}
+	LIGHTS_block = glGetUniformBlockIndex(program, "Lights");
+	if (LIGHTS_block != -1U) {
+		glUniformBlockBinding(program, LIGHTS_block, Scene::LightsBinding);
+	}
+
+	OBJECT_LIGHT_COUNT_int = glGetUniformLocation(program, "OBJECT_LIGHT_COUNT");
+	OBJECT_LIGHTS_int_array = glGetUniformLocation(program, "OBJECT_LIGHTS");
 
 
 	GLuint TEX_sampler2D = glGetUniformLocation(program, "TEX");
@@ -150,6 +333,17 @@ LitColorTextureProgram::LitColorTextureProgram() {
 
 	glUniform1i(TEX_sampler2D, 0); //set TEX to sample from GL_TEXTURE0
 
+	//clustered lighting data is bound by Scene::draw to fixed texture units:
+	if (variant & Clustered) {
+		CLUSTERS_block = glGetUniformBlockIndex(program, "Clusters");
+		if (CLUSTERS_block != -1U) {
+			glUniformBlockBinding(program, CLUSTERS_block, Scene::ClustersBinding);
+		}
+		glUniform1i(glGetUniformLocation(program, "LIGHT_DATA"), Scene::ClusterTextureUnit + 0);
+		glUniform1i(glGetUniformLocation(program, "CLUSTER_CELLS"), Scene::ClusterTextureUnit + 1);
+		glUniform1i(glGetUniformLocation(program, "CLUSTER_LIGHTS"), Scene::ClusterTextureUnit + 2);
+	}
+
 	glUseProgram(0); //unbind program -- glUniform* calls refer to ??? now
 }
 
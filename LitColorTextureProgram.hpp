@@ -6,7 +6,15 @@
 
 //Shader program that draws transformed, lit, textured vertices tinted with vertex colors:
 struct LitColorTextureProgram {
-	LitColorTextureProgram();
+	//Variants of the program (selected by #define's in the shader source; can be combined with '|'):
+	enum Variant : uint32_t {
+		Basic = 0, //per-object matrices are plain uniforms, lights are picked per-object
+		Instanced = 1, //object-to-world matrix comes from a per-instance attribute (see Scene::Drawable::Pipeline::Instanced)
+		ObjectBlock = 2, //per-object matrices come from the ObjectMatrices uniform block (see Scene::Drawable::Pipeline::OBJECT_MATRICES_block)
+		Clustered = 4, //lights come from Scene's light clusters (see Scene::Drawable::Pipeline::clustered_lights)
+		Quantized = 8, //vertices are in MeshBuffer::Quantized layout (see Scene::Drawable::Pipeline::position_offset)
+	};
+	LitColorTextureProgram(uint32_t variant = Basic);
 	~LitColorTextureProgram();
 
 	GLuint program = 0;
@@ -16,25 +24,56 @@ struct LitColorTextureProgram {
 	GLuint Normal_vec3 = -1U;
 	GLuint Color_vec4 = -1U;
 	GLuint TexCoord_vec2 = -1U;
+	GLuint WORLD_FROM_OBJECT_mat4x3 = -1U; //(instanced variant only)
 
 	//Uniform (per-invocation variable) locations:
 	GLuint CLIP_FROM_OBJECT_mat4 = -1U;
 	GLuint LIGHT_FROM_OBJECT_mat4x3 = -1U;
 	GLuint LIGHT_FROM_NORMAL_mat3 = -1U;
+	//(instanced variant uses these instead of the above)
+	GLuint CLIP_FROM_WORLD_mat4 = -1U;
+	GLuint LIGHT_FROM_WORLD_mat4x3 = -1U;
+	//(object block variant uses this instead of the above)
+	GLuint OBJECT_MATRICES_block = -1U;
 
-	//lighting:
-	GLuint LIGHT_TYPE_int = -1U;
-	GLuint LIGHT_LOCATION_vec3 = -1U;
-	GLuint LIGHT_DIRECTION_vec3 = -1U;
-	GLuint LIGHT_ENERGY_vec3 = -1U;
-	GLuint LIGHT_CUTOFF_float = -1U;
+	//lighting (lights come from the Lights block, attached to Scene::LightsBinding -- see Scene::draw):
+	GLuint LIGHTS_block = -1U;
+	GLuint OBJECT_LIGHT_COUNT_int = -1U;
+	GLuint OBJECT_LIGHTS_int_array = -1U;
+	GLuint CLUSTERS_block = -1U; //(clustered variant only)
+
+	//dequantization (quantized variant only):
+	GLuint POSITION_OFFSET_vec3 = -1U;
+	GLuint POSITION_SCALE_vec3 = -1U;
 	
 	//Textures:
 	//TEXTURE0 - texture that is accessed by TexCoord
 };
 
+//n.b. only the quantized variants are compiled at startup; the others are compiled on first access (LoadLazy),
+// which is also when their pipeline templates (below) get filled in -- so touch the Load before copying its template.
 extern Load< LitColorTextureProgram > lit_color_texture_program;
+extern Load< LitColorTextureProgram > lit_color_texture_program_instanced;
+extern Load< LitColorTextureProgram > lit_color_texture_program_object_block;
+extern Load< LitColorTextureProgram > lit_color_texture_program_clustered;
+extern Load< LitColorTextureProgram > lit_color_texture_program_clustered_instanced;
+extern Load< LitColorTextureProgram > lit_color_texture_program_quantized;
+extern Load< LitColorTextureProgram > lit_color_texture_program_quantized_instanced;
 
-//For convenient scene-graph setup, copy this object:
+//For convenient scene-graph setup, copy this object (after accessing lit_color_texture_program):
 // NOTE: by default, has texture bound to 1-pixel white texture -- so it's okay to use with vertex-color-only meshes.
+// NOTE: pipeline.instanced.program is set, but you'll need to set pipeline.instanced.vao to enable instancing (see MeshBuffer::make_instanced_vao_for_program).
 extern Scene::Drawable::Pipeline lit_color_texture_program_pipeline;
+
+//Same as above, but using lit_color_texture_program_object_block:
+// (make the vao with lit_color_texture_program_object_block->program)
+extern Scene::Drawable::Pipeline lit_color_texture_program_object_block_pipeline;
+
+//Same as above, but using clustered lighting (lit_color_texture_program_clustered and, for instancing, lit_color_texture_program_clustered_instanced):
+// (good for scenes with many lights)
+extern Scene::Drawable::Pipeline lit_color_texture_program_clustered_pipeline;
+
+//Same as lit_color_texture_program_pipeline, but for meshes loaded with the MeshBuffer::Quantized layout:
+// (make vaos with lit_color_texture_program_quantized and lit_color_texture_program_quantized_instanced,
+//  and copy each mesh's position_offset and position_scale into the pipeline)
+extern Scene::Drawable::Pipeline lit_color_texture_program_quantized_pipeline;
@@ -3,12 +3,23 @@
 #include <array>
 #include <list>
 #include <cassert>
+#include <chrono>
+#include <iostream>
+#include <exception>
 
 namespace {
 	std::array< std::list< std::function< void() > >, MaxLoadTag > &get_load_lists() {
 		static std::array< std::list< std::function< void() > >, MaxLoadTag > load_lists;
 		return load_lists;
 	}
+	std::array< std::list< std::function< void() > >, MaxLoadTag > &get_prefetch_lists() {
+		static std::array< std::list< std::function< void() > >, MaxLoadTag > prefetch_lists;
+		return prefetch_lists;
+	}
+	bool &get_load_functions_called() {
+		static bool has_been_called = false;
+		return has_been_called;
+	}
 }
 
 void add_load_function(LoadTag tag, std::function< void() > const &fn) {
@@ -18,7 +29,7 @@ void add_load_function(LoadTag tag, std::function< void() > const &fn) {
 }
 
 void call_load_functions() {
-	static bool has_been_called = false;
+	bool &has_been_called = get_load_functions_called();
 	assert(!has_been_called && "call_load_functions should only be called *once*");
 	has_been_called = true;
 
@@ -30,3 +41,41 @@ void call_load_functions() {
 		}
 	}
 }
+
+bool load_functions_called() {
+	return get_load_functions_called();
+}
+
+void add_prefetch_function(LoadTag tag, std::function< void() > const &fn) {
+	auto &prefetch_lists = get_prefetch_lists();
+	assert(tag < prefetch_lists.size());
+	prefetch_lists[tag].emplace_back(fn);
+}
+
+bool call_prefetch_functions(float budget) {
+	assert(load_functions_called() && "call_prefetch_functions should only be called after call_load_functions");
+
+	auto start = std::chrono::high_resolution_clock::now();
+	auto &prefetch_lists = get_prefetch_lists();
+	for (auto &fn_list : prefetch_lists) {
+		while (!fn_list.empty()) {
+			std::function< void() > fn = std::move(*fn_list.begin());
+			fn_list.pop_front();
+			try {
+				fn();
+			} catch (std::exception &e) {
+				//a failed prefetch isn't retried here; the load will be re-attempted (and the error thrown) on first access:
+				std::cerr << "WARNING: prefetch failed: " << e.what() << std::endl;
+			}
+
+			float elapsed = std::chrono::duration< float >(std::chrono::high_resolution_clock::now() - start).count();
+			if (elapsed >= budget) {
+				for (auto const &remaining : prefetch_lists) {
+					if (!remaining.empty()) return true;
+				}
+				return false;
+			}
+		}
+	}
+	return false;
+}
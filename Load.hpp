@@ -20,11 +20,22 @@
  * These functions are grouped by 'tags', which allow some sequencing of calls.
  * (particularly, this is useful for loading large data blobs [e.g. Meshes] before looking up individual elements within them.)
  *
+ * A Load< T > may also be given a 'LoadPolicy' to defer loading until the resource is actually used:
+ *
+ * Load< Sound::Sample > rarely_used_sample(LoadTagDefault, []() -> Sound::Sample const * {
+ *     return new Sound::Sample(data_path("rare.opus"));
+ * }, LoadLazyPrefetch);
+ *
+ * Lazy loads happen on first access (operator->, operator*, etc).
+ * LoadLazyPrefetch loads additionally get loaded during idle time by call_prefetch_functions(),
+ *  which the main loop calls between frames. (These run on the main thread, since most loaders use OpenGL.)
+ *
  */
 
 #include <functional>
 #include <stdexcept>
 #include <cstdint>
+#include <cassert>
 
 enum LoadTag : uint32_t {
 	LoadTagEarly,
@@ -33,6 +44,12 @@ enum LoadTag : uint32_t {
 	MaxLoadTag //<-- just used to track # of load tags
 };
 
+enum LoadPolicy : uint32_t {
+	LoadEager, //load during call_load_functions() (default)
+	LoadLazy, //load on first access
+	LoadLazyPrefetch, //load on first access or when call_prefetch_functions() gets to it, whichever is first
+};
+
 //Add a function to an internal list of loading functions:
 // (only call *before* "call_load_functions()")
 void add_load_function(LoadTag tag, std::function< void() > const &fn);
@@ -42,6 +59,19 @@ void add_load_function(LoadTag tag, std::function< void() > const &fn);
 // (only call *once*)
 void call_load_functions();
 
+//has call_load_functions() been called yet?
+// (lazy loads check this, since they generally need an OpenGL context)
+bool load_functions_called();
+
+//Add a function to an internal list of prefetch functions:
+// (used by LoadLazyPrefetch; prefetch functions should do nothing if their resource is already loaded)
+void add_prefetch_function(LoadTag tag, std::function< void() > const &fn);
+
+//Call prefetch functions until the list is empty or 'budget' seconds have passed:
+// (only call *after* "call_load_functions()"; always calls at least one function if any remain)
+// returns 'true' if there are still prefetch functions remaining
+bool call_prefetch_functions(float budget);
+
 
 //work-around for MSVC not accepting this as a lambda:
 template< typename T >
@@ -50,22 +80,48 @@ T const *new_T() { return new T; }
 template< typename T >
 struct Load {
 	//Constructing a Load< T > adds the passed function to the list of functions to call:
-	Load(LoadTag tag, const std::function< T const *() > &load_fn = new_T< T >) : value(nullptr) {
-		add_load_function(tag, [this,load_fn](){
-			this->value = load_fn();
-			if (!(this->value)) {
+	// (or, for lazy policies, remembers it to call on first access)
+	Load(LoadTag tag, const std::function< T const *() > &load_fn = new_T< T >, LoadPolicy policy = LoadEager) : value(nullptr) {
+		if (policy == LoadEager) {
+			add_load_function(tag, [this,load_fn](){
+				this->value = load_fn();
+				if (!(this->value)) {
+					throw std::runtime_error("Loading failed.");
+				}
+			});
+		} else {
+			lazy_fn = load_fn;
+			if (policy == LoadLazyPrefetch) {
+				add_prefetch_function(tag, [this](){
+					this->get();
+				});
+			}
+		}
+	}
+
+	//Get the loaded value, running a deferred load function if needed:
+	T const *get() {
+		if (!value && lazy_fn) {
+			assert(load_functions_called() && "Lazy Load<> should not be accessed before call_load_functions()");
+			value = lazy_fn();
+			if (!value) {
 				throw std::runtime_error("Loading failed.");
 			}
-		});
+			lazy_fn = nullptr; //no longer needed
+		}
+		return value;
 	}
 
 	//Make a "Load< T >" behave like a "T const *":
-	explicit operator bool() { return value != nullptr; }
-	operator T const *() { return value; }
-	T const &operator*() { return *value; }
-	T const *operator->() { return value; }
+	explicit operator bool() { return get() != nullptr; }
+	operator T const *() { return get(); }
+	T const &operator*() { return *get(); }
+	T const *operator->() { return get(); }
 
 	T const *value;
+
+	//load function for lazy policies (cleared once loaded):
+	std::function< T const *() > lazy_fn;
 };
 
 
@@ -157,6 +157,7 @@ const game_names = [
 	maek.CPP('Sound.cpp'),
 	maek.CPP('load_wav.cpp'),
 	maek.CPP('load_opus.cpp'),
+	maek.CPP('sample_cache.cpp'),
 	maek.CPP('TextHB.cpp'),
 	maek.CPP('Dialogue.cpp')
 ];
@@ -168,7 +169,14 @@ const common_names = [
 	maek.CPP('DrawLines.cpp'),
 	maek.CPP('ColorProgram.cpp'),
 	maek.CPP('Scene.cpp'),
+	maek.CPP('TransformArray.cpp'),
+	maek.CPP('Jobs.cpp'),
+	maek.CPP('LightClusters.cpp'),
+	maek.CPP('resample.cpp'),
 	maek.CPP('Mesh.cpp'),
+	maek.CPP('MappedFile.cpp'),
+	maek.CPP('ChunkFile.cpp'),
+	maek.CPP('GeometryArena.cpp'),
 	maek.CPP('load_save_png.cpp'),
 	maek.CPP('gl_compile_program.cpp'),
 	maek.CPP('Mode.cpp'),
@@ -192,6 +200,14 @@ const freetype_test_names = [
 	maek.CPP('freetype-test.cpp')
 ];
 
+const bench_scene_names = [
+	maek.CPP('bench-scene.cpp')
+];
+
+const pnct_tool_names = [
+	maek.CPP('pnct-tool.cpp')
+];
+
 //the '[exeFile =] LINK(objFiles, exeFileBase, [, options])' links an array of objects into an executable:
 // objFiles: array of objects to link
 // exeFileBase: name of executable file to produce
@@ -201,9 +217,11 @@ const show_meshes_exe = maek.LINK([...show_meshes_names, ...common_names], 'scen
 const show_scene_exe = maek.LINK([...show_scene_names, ...common_names], 'scenes/show-scene');
 
 const freetype_test_exe = maek.LINK([...freetype_test_names], 'freetype-test');
+const bench_scene_exe = maek.LINK([...bench_scene_names, ...common_names], 'bench-scene');
+const pnct_tool_exe = maek.LINK([...pnct_tool_names], 'scenes/pnct-tool');
 
 //set the default target to the game (and copy the readme files):
-maek.TARGETS = [game_exe, show_meshes_exe, show_scene_exe, freetype_test_exe, ...copies];
+maek.TARGETS = [game_exe, show_meshes_exe, show_scene_exe, freetype_test_exe, bench_scene_exe, pnct_tool_exe, ...copies];
 
 //Note that tasks that produce ':abstract targets' are never cached.
 // This is similar to how .PHONY targets behave in make.
@@ -0,0 +1,78 @@
+#include "MappedFile.hpp"
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(std::string const &filename_) : filename(filename_) {
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open '" + filename + "' for mapping.");
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		CloseHandle(file);
+		throw std::runtime_error("Failed to get size of '" + filename + "'.");
+	}
+	size_ = size_t(file_size.QuadPart);
+
+	//(empty files can't be mapped, but there's nothing to map anyway)
+	if (size_ != 0) {
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping != NULL) {
+			data_ = static_cast< char const * >(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		}
+	}
+	CloseHandle(file); //(the mapping keeps the file open)
+
+	if (size_ != 0 && data_ == nullptr) {
+		if (mapping) CloseHandle(mapping);
+		throw std::runtime_error("Failed to map '" + filename + "'.");
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (data_) UnmapViewOfFile(data_);
+	if (mapping) CloseHandle(mapping);
+}
+
+#else //POSIX
+
+MappedFile::MappedFile(std::string const &filename_) : filename(filename_) {
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd == -1) {
+		throw std::runtime_error("Failed to open '" + filename + "' for mapping.");
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		throw std::runtime_error("Failed to get size of '" + filename + "'.");
+	}
+	size_ = size_t(info.st_size);
+
+	//(empty files can't be mapped, but there's nothing to map anyway)
+	if (size_ != 0) {
+		void *ptr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr == MAP_FAILED) {
+			close(fd);
+			throw std::runtime_error("Failed to map '" + filename + "'.");
+		}
+		data_ = static_cast< char const * >(ptr);
+	}
+	close(fd); //(the mapping keeps the file open)
+}
+
+MappedFile::~MappedFile() {
+	if (data_) munmap(const_cast< char * >(data_), size_);
+}
+
+#endif
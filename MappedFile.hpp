@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+//Read-only view of a whole file, mapped into memory (mmap on POSIX, MapViewOfFile on Windows):
+// pages are loaded on first access and shared with the OS page cache, so nothing is copied up front.
+// note: the constructor will throw if the file can't be opened or mapped.
+
+struct MappedFile {
+	MappedFile(std::string const &filename);
+	~MappedFile();
+
+	//the mapping is owned by this object:
+	MappedFile(MappedFile const &) = delete;
+	MappedFile &operator=(MappedFile const &) = delete;
+
+	char const *data() const { return data_; }
+	size_t size() const { return size_; }
+
+	std::string filename;
+
+	//-- internals --
+	char const *data_ = nullptr; //(nullptr for empty files)
+	size_t size_ = 0;
+	void *mapping = nullptr; //(Windows only) file mapping object
+};
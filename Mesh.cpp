@@ -1,23 +1,54 @@
 #include "Mesh.hpp"
-#include "read_write_chunk.hpp"
+#include "ChunkFile.hpp"
+#include "GeometryArena.hpp"
 
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include <stdexcept>
-#include <fstream>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <set>
+#include <span>
 #include <cstddef>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cassert>
 
-MeshBuffer::MeshBuffer(std::string const &filename) {
-	glGenBuffers(1, &buffer);
+//FNV-1a, used for MeshBuffer::name_table:
+static uint32_t hash_name(std::string_view name) {
+	uint32_t hash = 2166136261U;
+	for (char c : name) {
+		hash ^= uint8_t(c);
+		hash *= 16777619U;
+	}
+	return hash;
+}
 
-	std::ifstream file(filename, std::ios::binary);
+//helpers for the Quantized layout:
+static int16_t snorm16(float x) {
+	return int16_t(std::round(std::clamp(x, -1.0f, 1.0f) * 32767.0f));
+}
 
-	GLuint total = 0;
+//octahedral normal encoding: project onto the octahedron |x|+|y|+|z| = 1, then fold the lower half over the upper half:
+// (decoded by the vertex shader)
+static glm::i16vec2 octahedral_encode(glm::vec3 const &n) {
+	float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	if (l1 == 0.0f) return glm::i16vec2(0);
+	glm::vec2 p = glm::vec2(n.x, n.y) / l1;
+	if (n.z < 0.0f) {
+		p = glm::vec2(
+			(1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+			(1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f)
+		);
+	}
+	return glm::i16vec2(snorm16(p.x), snorm16(p.y));
+}
 
+//vertex formats of the layouts:
+namespace {
 	struct Vertex {
 		glm::vec3 Position;
 		glm::vec3 Normal;
@@ -25,30 +56,88 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 		glm::vec2 TexCoord;
 	};
 	static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
-	std::vector< Vertex > data;
 
-	//read + upload data chunk:
-	if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct") {
-		read_chunk(file, "pnct", &data);
+	struct QuantizedVertex {
+		glm::i16vec3 Position;
+		int16_t padding; //(keeps the remaining attributes 4-byte aligned)
+		glm::i16vec2 Normal;
+		glm::u8vec4 Color;
+		glm::u16vec2 TexCoord;
+	};
+	static_assert(sizeof(QuantizedVertex) == 3*2+2+2*2+4*1+2*2, "QuantizedVertex is packed.");
+}
+
+//all MeshBuffers with the same layout share an arena:
+// (arenas are reference-counted by their MeshBuffers, and deleted along with their buffers and vaos when the last one goes away)
+static GeometryArena *arenas[2] = { nullptr, nullptr };
+static uint32_t arena_users[2] = { 0, 0 };
+
+static GeometryArena *acquire_arena(MeshBuffer::Layout layout) {
+	uint32_t slot = (layout == MeshBuffer::Quantized ? 1 : 0);
+	if (arenas[slot] == nullptr) {
+		assert(arena_users[slot] == 0);
+		if (layout == MeshBuffer::Quantized) {
+			arenas[slot] = new GeometryArena(sizeof(QuantizedVertex), {
+				{"Position", 3, GL_SHORT, GL_TRUE, offsetof(QuantizedVertex, Position)},
+				{"Normal", 2, GL_SHORT, GL_TRUE, offsetof(QuantizedVertex, Normal)},
+				{"Color", 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(QuantizedVertex, Color)},
+				{"TexCoord", 2, GL_HALF_FLOAT, GL_FALSE, offsetof(QuantizedVertex, TexCoord)},
+			});
+		} else {
+			arenas[slot] = new GeometryArena(sizeof(Vertex), {
+				{"Position", 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Position)},
+				{"Normal", 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, Normal)},
+				{"Color", 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(Vertex, Color)},
+				{"TexCoord", 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, TexCoord)},
+			});
+		}
+	}
+	arena_users[slot] += 1;
+	return arenas[slot];
+}
+
+static void release_arena(MeshBuffer::Layout layout) {
+	uint32_t slot = (layout == MeshBuffer::Quantized ? 1 : 0);
+	assert(arena_users[slot] > 0);
+	arena_users[slot] -= 1;
+	if (arena_users[slot] == 0) {
+		delete arenas[slot];
+		arenas[slot] = nullptr;
+	}
+}
+
+MeshBuffer::MeshBuffer(std::string const &filename, Layout layout_) : layout(layout_) {
+
+	//the file is mapped rather than read, so vertex data can be uploaded straight from the page cache:
+	ChunkFile file(filename);
+
+	GLuint total = 0;
+
+	Vertex const *data = nullptr;
+	std::vector< Vertex > unaligned_vertices; //(only used if the 'pnct' chunk isn't the first in the file)
+
+	std::vector< QuantizedVertex > quantized; //(filled in per-mesh, since positions are relative to mesh bounds)
+	std::vector< bool > quantized_claimed;
 
-		//upload data:
-		glBindBuffer(GL_ARRAY_BUFFER, buffer);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	char const *index_data = nullptr; //(in the mapping; uploaded along with the vertices)
 
-		total = GLuint(data.size()); //store total for later checks on index
+	//locate data chunk:
+	if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct") {
+		std::span< Vertex const > vertices = file.view< Vertex >("pnct", &unaligned_vertices);
+		data = vertices.data();
 
-		//store attrib locations:
-		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
-		Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
-		Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), offsetof(Vertex, Color));
-		TexCoord = Attrib(2, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, TexCoord));
+		total = GLuint(vertices.size()); //store total for later checks on index
 	} else {
 		throw std::runtime_error("Unknown file type '" + filename + "'");
 	}
 
-	std::vector< char > strings;
-	read_chunk(file, "str0", &strings);
+	if (layout == Quantized) {
+		quantized.assign(total, QuantizedVertex{ });
+		quantized_claimed.assign(total, false);
+	}
+
+	std::span< char const > strings = file.view< char >("str0");
+	name_chars.assign(strings.begin(), strings.end());
 
 	{ //read index chunk, add to meshes:
 		struct IndexEntry {
@@ -57,94 +146,317 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 		};
 		static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
 
-		std::vector< IndexEntry > index;
-		read_chunk(file, "idx0", &index);
+		std::vector< IndexEntry > unaligned_index;
+		std::span< IndexEntry const > index = file.view< IndexEntry >("idx0", &unaligned_index);
+
+		//optional chunks:
+		// 'bnd1' - precomputed bounds and metadata (one per index entry)
+		// 'bnd0' - precomputed bounding boxes (one per index entry; older files)
+		// 'ind0' - index ranges (one per index entry), along with 'ix16' or 'ix32' - the indices
+		// 'lod0' - levels of detail (any number per index entry)
+		struct Bounds {
+			glm::vec3 min, max;
+		};
+		static_assert(sizeof(Bounds) == 24, "Bounds should be packed");
+
+		struct BoundsEntry {
+			glm::vec3 min, max;
+			glm::vec3 center;
+			float radius;
+			uint32_t vertex_count;
+			uint32_t material_begin, material_end; //material name, in the string chunk
+		};
+		static_assert(sizeof(BoundsEntry) == 52, "Bounds entry should be packed");
+
+		struct IndexRange {
+			uint32_t index_begin, index_end;
+		};
+		static_assert(sizeof(IndexRange) == 8, "Index range should be packed");
+
+		struct LODEntry {
+			uint32_t mesh; //index entry this is a level of detail for
+			uint32_t vertex_begin, vertex_end;
+			float max_screen_size;
+		};
+		static_assert(sizeof(LODEntry) == 16, "LOD entry should be packed");
+
+		//(tables in chunks that aren't aligned are copied into these)
+		std::vector< Bounds > unaligned_bounds;
+		std::vector< BoundsEntry > unaligned_metadata;
+		std::vector< IndexRange > unaligned_ranges;
+
+		std::span< Bounds const > bounds;
+		std::span< BoundsEntry const > metadata;
+		std::span< IndexRange const > ranges;
+		std::vector< LODEntry > lods;
+		ChunkFile::Chunk indices;
+
+		if (ChunkFile::Chunk const *chunk = file.find("bnd1")) {
+			metadata = file.view< BoundsEntry >(*chunk, &unaligned_metadata);
+			if (metadata.size() != index.size()) {
+				throw std::runtime_error("bounds chunk doesn't match index chunk");
+			}
+		}
+		if (ChunkFile::Chunk const *chunk = file.find("bnd0")) {
+			bounds = file.view< Bounds >(*chunk, &unaligned_bounds);
+			if (bounds.size() != index.size()) {
+				throw std::runtime_error("bounds chunk doesn't match index chunk");
+			}
+		}
+		if (ChunkFile::Chunk const *chunk = file.find("lod0")) {
+			//(always copied, since they are sorted)
+			std::vector< LODEntry > unaligned_lods;
+			std::span< LODEntry const > entries = file.view< LODEntry >(*chunk, &unaligned_lods);
+			lods.assign(entries.begin(), entries.end());
+			for (auto const &lod : lods) {
+				if (!(lod.mesh < index.size() && lod.vertex_begin <= lod.vertex_end && lod.vertex_end <= total)) {
+					throw std::runtime_error("level of detail entry has out-of-range mesh or vertex start/count");
+				}
+			}
+			//group by mesh, finest (largest screen size) first:
+			std::stable_sort(lods.begin(), lods.end(), [](LODEntry const &a, LODEntry const &b) {
+				if (a.mesh != b.mesh) return a.mesh < b.mesh;
+				return a.max_screen_size > b.max_screen_size;
+			});
+		}
+		if (ChunkFile::Chunk const *chunk = file.find("ind0")) {
+			ranges = file.view< IndexRange >(*chunk, &unaligned_ranges);
+			if (ranges.size() != index.size()) {
+				throw std::runtime_error("index range chunk doesn't match index chunk");
+			}
+		}
+		for (char const *magic : {"ix16", "ix32"}) {
+			ChunkFile::Chunk const *chunk = file.find(magic);
+			if (!chunk) continue;
+			indices = *chunk;
+			index_type = (chunk->magic == "ix16" ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+			if (indices.size % (index_type == GL_UNSIGNED_SHORT ? 2 : 4) != 0) {
+				throw std::runtime_error("Size of '" + chunk->magic + "' chunk not divisible by index size");
+			}
+		}
+
+		for (ChunkFile::Chunk const &chunk : file.chunks) {
+			static std::set< std::string > const known{"pnct", "str0", "idx0", "bnd1", "bnd0", "lod0", "ind0", "ix16", "ix32"};
+			if (!known.count(chunk.magic)) {
+				std::cerr << "WARNING: ignoring unknown chunk '" << chunk.magic << "' in mesh file '" << filename << "'" << std::endl;
+			}
+		}
+		if (file.trailing != 0) {
+			std::cerr << "WARNING: trailing data in mesh file '" << filename << "'" << std::endl;
+		}
 
-		for (auto const &entry : index) {
+		if (!ranges.empty() && indices.data == nullptr) {
+			throw std::runtime_error("index range chunk isn't accompanied by an 'ix16' or 'ix32' chunk");
+		}
+		size_t index_size = (index_type == GL_UNSIGNED_SHORT ? 2 : 4);
+		size_t index_total = indices.size / index_size;
+		if (!ranges.empty()) {
+			index_data = indices.data;
+			index_bytes = uint32_t(indices.size);
+		}
+
+		//largest index in [begin,end) of the index chunk:
+		auto max_index = [&](uint32_t begin, uint32_t end) -> uint32_t {
+			uint32_t ret = 0;
+			for (uint32_t i = begin; i < end; ++i) {
+				if (index_type == GL_UNSIGNED_SHORT) {
+					uint16_t value;
+					std::memcpy(&value, indices.data + i * index_size, sizeof(value));
+					ret = std::max< uint32_t >(ret, value);
+				} else {
+					uint32_t value;
+					std::memcpy(&value, indices.data + i * index_size, sizeof(value));
+					ret = std::max< uint32_t >(ret, value);
+				}
+			}
+			return ret;
+		};
+
+		auto next_lod = lods.begin();
+
+		meshes.reserve(index.size());
+		name_ranges.reserve(index.size());
+		uint32_t table_size = 1;
+		while (table_size < 2 * index.size()) table_size *= 2;
+		name_table.assign(table_size, -1U);
+
+		for (uint32_t e = 0; e < index.size(); ++e) {
+			IndexEntry const &entry = index[e];
 			if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
 				throw std::runtime_error("index entry has out-of-range name begin/end");
 			}
 			if (!(entry.vertex_begin <= entry.vertex_end && entry.vertex_end <= total)) {
 				throw std::runtime_error("index entry has out-of-range vertex start/count");
 			}
-			std::string name(&strings[0] + entry.name_begin, &strings[0] + entry.name_end);
+			std::string_view name(name_chars.data() + entry.name_begin, entry.name_end - entry.name_begin);
 			Mesh mesh;
 			mesh.type = GL_TRIANGLES;
 			mesh.start = entry.vertex_begin;
 			mesh.count = entry.vertex_end - entry.vertex_begin;
-			for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) {
-				mesh.min = glm::min(mesh.min, data[v].Position);
-				mesh.max = glm::max(mesh.max, data[v].Position);
+			if (!ranges.empty()) {
+				IndexRange const &range = ranges[e];
+				if (!(range.index_begin <= range.index_end && range.index_end <= index_total)) {
+					throw std::runtime_error("index range has out-of-range index begin/end");
+				}
+				if (range.index_begin < range.index_end && max_index(range.index_begin, range.index_end) >= mesh.count) {
+					throw std::runtime_error("index range for mesh '" + std::string(name) + "' refers to vertices outside the mesh");
+				}
+				mesh.index_type = index_type;
+				mesh.index_start = range.index_begin;
+				mesh.index_count = range.index_end - range.index_begin;
+			}
+			if (!metadata.empty()) {
+				BoundsEntry const &meta = metadata[e];
+				if (meta.vertex_count != mesh.count) {
+					throw std::runtime_error("bounds entry for mesh '" + std::string(name) + "' has the wrong vertex count");
+				}
+				if (!(meta.material_begin <= meta.material_end && meta.material_end <= strings.size())) {
+					throw std::runtime_error("bounds entry has out-of-range material begin/end");
+				}
+				mesh.min = meta.min;
+				mesh.max = meta.max;
+				mesh.center = meta.center;
+				mesh.radius = meta.radius;
+				mesh.material = std::string(strings.data() + meta.material_begin, strings.data() + meta.material_end);
+			} else {
+				if (!bounds.empty()) {
+					mesh.min = bounds[e].min;
+					mesh.max = bounds[e].max;
+				} else {
+					for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) {
+						mesh.min = glm::min(mesh.min, data[v].Position);
+						mesh.max = glm::max(mesh.max, data[v].Position);
+					}
+				}
+				//(without precomputed spheres, use the box's circumsphere)
+				if (mesh.count != 0) {
+					mesh.center = 0.5f * (mesh.max + mesh.min);
+					mesh.radius = 0.5f * glm::length(mesh.max - mesh.min);
+				}
+			}
+			for (; next_lod != lods.end() && next_lod->mesh == e; ++next_lod) {
+				if (mesh.lod_count == Mesh::MaxLODs) {
+					std::cerr << "WARNING: mesh '" << name << "' in '" << filename << "' has more than " << Mesh::MaxLODs << " levels of detail; ignoring the coarsest." << std::endl;
+					continue;
+				}
+				Mesh::LOD &lod = mesh.lods[mesh.lod_count++];
+				lod.start = next_lod->vertex_begin;
+				lod.count = next_lod->vertex_end - next_lod->vertex_begin;
+				lod.max_screen_size = next_lod->max_screen_size;
 			}
-			bool inserted = meshes.insert(std::make_pair(name, mesh)).second;
-			if (!inserted) {
-				std::cerr << "WARNING: mesh name '" + name + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
+			if (layout == Quantized && mesh.count != 0) {
+				mesh.position_offset = 0.5f * (mesh.max + mesh.min);
+				mesh.position_scale = 0.5f * (mesh.max - mesh.min);
+				auto quantize = [&](float x, uint32_t c) -> int16_t {
+					return mesh.position_scale[c] > 0.0f ? snorm16((x - mesh.position_offset[c]) / mesh.position_scale[c]) : 0;
+				};
+				//(levels of detail are quantized relative to the full mesh's bounds, so they can share its dequantization parameters)
+				auto quantize_range = [&](uint32_t begin, uint32_t end) {
+					for (uint32_t v = begin; v < end; ++v) {
+						if (quantized_claimed[v]) {
+							throw std::runtime_error("Quantized layout requires meshes with disjoint vertex ranges, but '" + filename + "' has overlapping meshes.");
+						}
+						quantized_claimed[v] = true;
+						QuantizedVertex &q = quantized[v];
+						q.Position = glm::i16vec3(quantize(data[v].Position.x, 0), quantize(data[v].Position.y, 1), quantize(data[v].Position.z, 2));
+						q.Normal = octahedral_encode(data[v].Normal);
+						q.Color = data[v].Color;
+						q.TexCoord = glm::u16vec2(glm::packHalf1x16(data[v].TexCoord.x), glm::packHalf1x16(data[v].TexCoord.y));
+					}
+				};
+				quantize_range(entry.vertex_begin, entry.vertex_end);
+				for (uint32_t l = 0; l < mesh.lod_count; ++l) {
+					quantize_range(mesh.lods[l].start, mesh.lods[l].start + mesh.lods[l].count);
+				}
+			}
+
+			//find the name's slot in the table (or an existing mesh with the same name):
+			uint32_t slot = hash_name(name) & (table_size - 1);
+			while (name_table[slot] != -1U && this->name(MeshId{name_table[slot]}) != name) {
+				slot = (slot + 1) & (table_size - 1);
+			}
+			if (name_table[slot] != -1U) {
+				std::cerr << "WARNING: mesh name '" << name << "' in filename '" << filename << "' collides with existing mesh." << std::endl;
+			} else {
+				name_table[slot] = uint32_t(meshes.size());
+				meshes.emplace_back(mesh);
+				name_ranges.emplace_back(entry.name_begin, entry.name_end);
 			}
 		}
 	}
 
-	if (file.peek() != EOF) {
-		std::cerr << "WARNING: trailing data in mesh file '" << filename << "'" << std::endl;
+	//upload data to the arena:
+	// (meshes are stored relative to the start of the file's data until this point)
+	// (the arena is only acquired here, once nothing else can throw, so a failed load never holds a reference)
+	arena = acquire_arena(layout);
+	if (layout == Quantized) {
+		vertex_first = arena->allocate_vertices(total, quantized.data());
+	} else {
+		vertex_first = arena->allocate_vertices(total, data);
+	}
+	vertex_count = total;
+	if (index_data != nullptr) {
+		index_offset = arena->allocate_indices(index_bytes, index_data);
+	}
+	for (Mesh &mesh : meshes) {
+		mesh.start += vertex_first;
+		for (uint32_t l = 0; l < mesh.lod_count; ++l) {
+			mesh.lods[l].start += vertex_first;
+		}
+		if (mesh.index_count != 0) {
+			mesh.index_start += index_offset / (index_type == GL_UNSIGNED_SHORT ? 2 : 4);
+		}
 	}
 
 	/* //DEBUG:
 	std::cout << "File '" << filename << "' contained meshes";
-	for (auto const &m : meshes) {
-		if (&m.second == &meshes.rbegin()->second && meshes.size() > 1) std::cout << " and";
-		std::cout << " '" << m.first << "'";
-		if (&m.second != &meshes.rbegin()->second) std::cout << ",";
+	for (uint32_t m = 0; m < size(); ++m) {
+		if (m + 1 == size() && size() > 1) std::cout << " and";
+		std::cout << " '" << name(MeshId{m}) << "'";
+		if (m + 1 != size()) std::cout << ",";
 	}
 	std::cout << std::endl;
 	*/
 }
 
-const Mesh &MeshBuffer::lookup(std::string const &name) const {
-	auto f = meshes.find(name);
-	if (f == meshes.end()) {
-		throw std::runtime_error("Looking up mesh '" + name + "' that doesn't exist.");
+MeshBuffer::MeshId MeshBuffer::find(std::string_view name_) const {
+	if (name_table.empty()) return MeshId{};
+	uint32_t mask = uint32_t(name_table.size()) - 1;
+	for (uint32_t slot = hash_name(name_) & mask; name_table[slot] != -1U; slot = (slot + 1) & mask) {
+		if (name(MeshId{name_table[slot]}) == name_) return MeshId{name_table[slot]};
 	}
-	return f->second;
+	return MeshId{};
 }
 
-GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
-	//create a new vertex array object:
-	GLuint vao = 0;
-	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
-
-	//Try to bind all attributes in this buffer:
-	std::set< GLuint > bound;
-	glBindBuffer(GL_ARRAY_BUFFER, buffer);
-	auto bind_attribute = [&](char const *name, MeshBuffer::Attrib const &attrib) {
-		if (attrib.size == 0) return; //don't bind empty attribs
-		GLint location = glGetAttribLocation(program, name);
-		if (location == -1) return; //can't bind missing attribs
-		glVertexAttribPointer(location, attrib.size, attrib.type, attrib.normalized, attrib.stride, (GLbyte *)0 + attrib.offset);
-		glEnableVertexAttribArray(location);
-		bound.insert(location);
-	};
-	bind_attribute("Position", Position);
-	bind_attribute("Normal", Normal);
-	bind_attribute("Color", Color);
-	bind_attribute("TexCoord", TexCoord);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
-
-	//Check that all active attributes were bound:
-	GLint active = 0;
-	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &active);
-	assert(active >= 0 && "Doesn't makes sense to have negative active attributes.");
-	for (GLuint i = 0; i < GLuint(active); ++i) {
-		GLchar name[100];
-		GLint size = 0;
-		GLenum type = 0;
-		glGetActiveAttrib(program, i, 100, NULL, &size, &type, name);
-		name[99] = '\0';
-		GLint location = glGetAttribLocation(program, name);
-		if (!bound.count(GLuint(location))) {
-			throw std::runtime_error("ERROR: active attribute '" + std::string(name) + "' in program is not bound.");
-		}
+std::string_view MeshBuffer::name(MeshId id) const {
+	assert(id.index < name_ranges.size());
+	glm::uvec2 range = name_ranges[id.index];
+	return std::string_view(name_chars.data() + range.x, range.y - range.x);
+}
+
+Mesh const &MeshBuffer::lookup(MeshId id) const {
+	assert(id.index < meshes.size());
+	return meshes[id.index];
+}
+
+const Mesh &MeshBuffer::lookup(std::string_view name_) const {
+	MeshId id = find(name_);
+	if (!id) {
+		throw std::runtime_error("Looking up mesh '" + std::string(name_) + "' that doesn't exist.");
 	}
+	return meshes[id.index];
+}
+
+MeshBuffer::~MeshBuffer() {
+	arena->free_vertices(vertex_first, vertex_count);
+	arena->free_indices(index_offset, index_bytes);
+	release_arena(layout);
+}
+
+GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
+	return arena->make_vao_for_program(program, false);
+}
 
-	return vao;
+GLuint MeshBuffer::make_instanced_vao_for_program(GLuint program) const {
+	return arena->make_vao_for_program(program, true);
 }
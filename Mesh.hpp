@@ -2,69 +2,141 @@
 
 /*
  * In this code, "Mesh" is a range of vertices that should be sent through
- *  the OpenGL pipeline together.
- * A "MeshBuffer" holds a collection of such meshes (loaded from a file) in
- *  a single OpenGL array buffer. Individual meshes can be looked up by name
- *  using the MeshBuffer::lookup() function.
+ *  the OpenGL pipeline together (optionally, through a range of indices).
+ * A "MeshBuffer" holds a collection of such meshes (loaded from a file).
+ *  Their data is stored in a GeometryArena shared by all MeshBuffers with
+ *  the same layout, so meshes from different files can be drawn with the
+ *  same vertex array object. Individual meshes can be looked up by name
+ *  using MeshBuffer::find(), which returns a MeshBuffer::MeshId handle that
+ *  can be used to fetch the mesh later without touching strings.
+ * The buffer can store vertices as loaded (MeshBuffer::Full) or in a compact
+ *  quantized layout (MeshBuffer::Quantized) that shaders must decode.
  *
  */
 
 #include "GL.hpp"
+#include "GeometryArena.hpp"
 #include <glm/glm.hpp>
-#include <map>
 #include <limits>
 #include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
 
 
 struct Mesh {
-	//Meshes are vertex ranges (and primitive types) in their MeshBuffer:
+	//Meshes are vertex ranges (and primitive types) in their MeshBuffer's arena:
 
 	GLenum type = GL_TRIANGLES; //type of primitives in mesh
 	GLuint start = 0; //index of first vertex
 	GLuint count = 0; //count of vertices
 
+	//Indexed meshes also have a range in their MeshBuffer's arena's index buffer:
+	// (indices are relative to 'start', so draw with glDrawElementsBaseVertex)
+	GLenum index_type = GL_UNSIGNED_SHORT; //GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	GLuint index_start = 0; //index of first index
+	GLuint index_count = 0; //count of indices; zero means "not indexed"
+
 	//Bounding box.
 	//useful for debug visualization and (perhaps, eventually) collision detection:
 	glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
 	glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+
+	//Bounding sphere (usually tighter than the box's circumsphere when precomputed by the exporter or pnct-tool):
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = -1.0f; //(negative for empty meshes)
+
+	//Coarser levels of detail (from a 'lod0' chunk, as written by pnct-tool --lods), finest first:
+	// these are unindexed vertex ranges in the same buffer, drawn with the same primitive type
+	struct LOD {
+		GLuint start = 0; //index of first vertex
+		GLuint count = 0; //count of vertices
+		float max_screen_size = 0.0f; //use this level when the bounding sphere covers at most this fraction of the screen height
+	};
+	enum : uint32_t { MaxLODs = 4 };
+	LOD lods[MaxLODs];
+	uint32_t lod_count = 0;
+
+	//Name of the mesh's material in the source file (may be empty):
+	// a hint for picking a pipeline or textures; MeshBuffer doesn't use it
+	std::string material;
+
+	//Dequantization parameters (MeshBuffer::Quantized layout only):
+	// object-space position = position_offset + position_scale * Position
+	glm::vec3 position_offset = glm::vec3(0.0f);
+	glm::vec3 position_scale = glm::vec3(1.0f);
 };
 
 struct MeshBuffer {
+	//Layouts for vertex data in the buffer:
+	enum Layout : uint32_t {
+		//36 bytes: float Position[3], float Normal[3], u8 Color[4], float TexCoord[2]
+		Full = 0,
+		//20 bytes: snorm16 Position[3] (+ padding) relative to the mesh's bounds (see Mesh::position_offset and position_scale),
+		// snorm16 Normal[2] (octahedral encoding), u8 Color[4], half-float TexCoord[2]
+		Quantized = 1,
+	};
+
 	//construct from a file:
 	// note: will throw if file fails to read.
-	MeshBuffer(std::string const &filename);
+	MeshBuffer(std::string const &filename, Layout layout = Full);
+	//frees the buffer's ranges in its arena (e.g., when a level is unloaded):
+	// (the last buffer with a given layout also deletes the arena -- and with it, any vaos it handed out)
+	~MeshBuffer();
+
+	//(the arena ranges belong to one buffer, so it can't be copied)
+	MeshBuffer(MeshBuffer const &) = delete;
+	MeshBuffer &operator=(MeshBuffer const &) = delete;
+
+	Layout layout = Full;
+
+	//meshes are referred to by handles (indices in file order):
+	struct MeshId {
+		uint32_t index = -1U;
+		explicit operator bool() const { return index != -1U; }
+		bool operator==(MeshId const &) const = default;
+	};
+
+	uint32_t size() const { return uint32_t(meshes.size()); }
+
+	//find a mesh by name (returns a default MeshId if not found):
+	MeshId find(std::string_view name) const;
+	std::string_view name(MeshId id) const;
+
+	//get the mesh for a handle:
+	// note: id must be a valid handle from this buffer.
+	Mesh const &lookup(MeshId id) const;
 
 	//look up a particular mesh by name:
 	// note: will throw if mesh not found.
-	const Mesh &lookup(std::string const &name) const;
+	const Mesh &lookup(std::string_view name) const;
 	
-	//build a vertex array object that links this vbo to attributes to a program:
+	//get a vertex array object that links the arena's buffers to attributes of a program:
 	// note: will throw if program defines attributes not contained in this buffer
+	// vaos belong to the arena and are shared by all buffers with this layout (and all programs that use the same attribute locations), so don't delete them
+	// (they stay valid as long as some buffer with this layout does)
 	GLuint make_vao_for_program(GLuint program) const;
 
-	//This is the OpenGL vertex buffer object containing the mesh data:
-	GLuint buffer = 0;
+	//build a vertex array object for an instanced program (see Scene::Drawable::Pipeline::Instanced):
+	// like make_vao_for_program, but leaves the per-instance 'WORLD_FROM_OBJECT' attribute for Scene::draw to point at its instance data
+	GLuint make_instanced_vao_for_program(GLuint program) const;
 
-	//-- internals ---
+	//Where the buffer's data is stored:
+	GeometryArena *arena = nullptr;
+	uint32_t vertex_first = 0, vertex_count = 0; //range of vertices in the arena
+	uint32_t index_offset = 0, index_bytes = 0; //range of index data in the arena (bytes)
+	GLenum index_type = GL_UNSIGNED_SHORT; //type of the values in the index data
 
-	//used by the lookup() function:
-	std::map< std::string, Mesh > meshes;
+	//-- internals ---
 
-	//These 'Attrib' structures describe the location of various attributes within the buffer (in exactly format wanted by glVertexAttribPointer). They are set when the file is loaded and are used by the "make_vao_for_program" call:
-	struct Attrib {
-		GLint size = 0;
-		GLenum type = 0;
-		GLboolean normalized = GL_FALSE;
-		GLsizei stride = 0;
-		GLsizei offset = 0;
+	//meshes, indexed by MeshId:
+	std::vector< Mesh > meshes;
 
-		Attrib() = default;
-		Attrib(GLint size_, GLenum type_, GLboolean normalized_, GLsizei stride_, GLsizei offset_)
-		: size(size_), type(type_), normalized(normalized_), stride(stride_), offset(offset_) { }
-	};
+	//names are stored as ranges in a copy of the file's string table (the file itself is only mapped while loading):
+	std::vector< char > name_chars;
+	std::vector< glm::uvec2 > name_ranges; //[begin,end) in name_chars
 
-	Attrib Position;
-	Attrib Normal;
-	Attrib Color;
-	Attrib TexCoord;
+	//used by find(): open-addressed hash table (linear probing) of mesh indices, -1U marks an empty slot:
+	// (size is a power of two, at least twice the number of meshes)
+	std::vector< uint32_t > name_table;
 };
@@ -16,39 +16,57 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <random>
+#include <cstdio>
 
-GLuint hexapod_meshes_for_lit_color_texture_program = 0;
 Load< MeshBuffer > hexapod_meshes(LoadTagDefault, []() -> MeshBuffer const * {
-	MeshBuffer const *ret = new MeshBuffer(data_path("hexapod.pnct"));
-	hexapod_meshes_for_lit_color_texture_program = ret->make_vao_for_program(lit_color_texture_program->program);
-	return ret;
+	return new MeshBuffer(data_path("hexapod.pnct"), MeshBuffer::Quantized);
 });
 
 Load< Scene > hexapod_scene(LoadTagDefault, []() -> Scene const * {
-	return new Scene(data_path("hexapod.scene"), [&](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
+	return new Scene(data_path("hexapod.scene"), [&](Scene &scene, Scene::Transform *transform, std::string_view mesh_name){
 		Mesh const &mesh = hexapod_meshes->lookup(mesh_name);
 
 		scene.drawables.emplace_back(transform);
 		Scene::Drawable &drawable = scene.drawables.back();
 
-		drawable.pipeline = lit_color_texture_program_pipeline;
+		drawable.pipeline = lit_color_texture_program_quantized_pipeline;
 
-		drawable.pipeline.vao = hexapod_meshes_for_lit_color_texture_program;
+		//(vaos are cached by the mesh buffer, so every drawable shares the same two)
+		drawable.pipeline.vao = hexapod_meshes->make_vao_for_program(drawable.pipeline.program);
+		drawable.pipeline.instanced.vao = hexapod_meshes->make_instanced_vao_for_program(drawable.pipeline.instanced.program);
 		drawable.pipeline.type = mesh.type;
 		drawable.pipeline.start = mesh.start;
 		drawable.pipeline.count = mesh.count;
+		drawable.pipeline.index_type = mesh.index_type;
+		drawable.pipeline.index_start = mesh.index_start;
+		drawable.pipeline.index_count = mesh.index_count;
+		drawable.pipeline.position_offset = mesh.position_offset;
+		drawable.pipeline.position_scale = mesh.position_scale;
+
+		drawable.min = mesh.min;
+		drawable.max = mesh.max;
+		drawable.center = mesh.center;
+		drawable.radius = mesh.radius;
+
+		drawable.lod_count = mesh.lod_count;
+		for (uint32_t l = 0; l < mesh.lod_count; ++l) {
+			drawable.lods[l].start = mesh.lods[l].start;
+			drawable.lods[l].count = mesh.lods[l].count;
+			drawable.lods[l].max_screen_size = mesh.lods[l].max_screen_size;
+		}
 
 	});
 });
 
+//samples aren't needed for the first frame, so load them in idle time (or on first use):
 Load< Sound::Sample > dusty_floor_sample(LoadTagDefault, []() -> Sound::Sample const * {
 	return new Sound::Sample(data_path("dusty-floor.opus"));
-});
+}, LoadLazyPrefetch);
 
 
 Load< Sound::Sample > honk_sample(LoadTagDefault, []() -> Sound::Sample const * {
 	return new Sound::Sample(data_path("honk.wav"));
-});
+}, LoadLazyPrefetch);
 
 void PlayMode::move_selection(int delta) { //@With help of GPT
     if (finished) return;
@@ -118,6 +136,9 @@ bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
         } else if (evt.key.key == SDLK_RETURN) {
             confirm_selection();
             return true;
+        } else if (evt.key.key == SDLK_F3) {
+            show_audio_metrics = !show_audio_metrics;
+            return true;
         }
     }
     //GPT help debug
@@ -254,5 +275,50 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 
     text->end();
 
+	if (show_audio_metrics) draw_audio_metrics(drawable_size);
+
 	GL_ERRORS();
+}
+
+void PlayMode::draw_audio_metrics(glm::uvec2 const &drawable_size) {
+	Sound::Metrics metrics = Sound::get_metrics();
+
+	glDisable(GL_DEPTH_TEST);
+	float aspect = float(drawable_size.x) / float(drawable_size.y);
+	DrawLines lines(glm::mat4(
+		1.0f / aspect, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	));
+
+	constexpr float H = 0.05f;
+	glm::vec3 anchor = glm::vec3(-aspect + 0.5f * H, 1.0f - 1.5f * H, 0.0f);
+	auto line = [&](std::string const &str) {
+		lines.draw_text(str, anchor, glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f), glm::u8vec4(0x00, 0x00, 0x00, 0xff));
+		anchor.y -= 1.2f * H;
+	};
+	auto fixed = [](float value, int digits) {
+		char buf[32];
+		std::snprintf(buf, sizeof(buf), "%.*f", digits, value);
+		return std::string(buf);
+	};
+
+	line("audio: " + fixed(metrics.mix_seconds * 1000.0f, 2) + " / " + fixed(metrics.block_seconds * 1000.0f, 2) + " ms"
+		+ "  late blocks " + std::to_string(metrics.late_blocks));
+	line("voices: " + std::to_string(metrics.voices_mixed) + " mixed, " + std::to_string(metrics.voices_virtual) + " virtual");
+	line("level: peak " + fixed(metrics.peak, 3) + "  rms " + fixed(metrics.rms, 3));
+
+	//bar graph of recent load (fraction of each block's deadline spent mixing); the top line is the deadline:
+	float left = -aspect + 0.5f * H;
+	float bottom = anchor.y - 3.0f * H;
+	float width = 0.5f;
+	float height = 3.0f * H;
+	lines.draw(glm::vec3(left, bottom + height, 0.0f), glm::vec3(left + width, bottom + height, 0.0f), glm::u8vec4(0x88, 0x00, 0x00, 0xff));
+	for (uint32_t i = 0; i < Sound::Metrics::HistorySize; ++i) {
+		float x = left + width * (i + 0.5f) / Sound::Metrics::HistorySize;
+		float load = std::min(metrics.load_history[i], 1.5f);
+		glm::u8vec4 color = (load >= 1.0f ? glm::u8vec4(0xff, 0x00, 0x00, 0xff) : glm::u8vec4(0x00, 0x00, 0x00, 0xff));
+		lines.draw(glm::vec3(x, bottom, 0.0f), glm::vec3(x, bottom + height * load, 0.0f), color);
+	}
 }
\ No newline at end of file
@@ -61,6 +61,10 @@ struct PlayMode : Mode {
     void move_selection(int delta);
     void confirm_selection();
 	
+	//debug overlay of Sound::get_metrics() (toggled with F3):
+	bool show_audio_metrics = false;
+	void draw_audio_metrics(glm::uvec2 const &drawable_size);
+
 	//camera:
 	Scene::Camera *camera = nullptr;
 
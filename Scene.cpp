@@ -1,11 +1,19 @@
 #include "Scene.hpp"
 
 #include "gl_errors.hpp"
-#include "read_write_chunk.hpp"
+#include "ChunkFile.hpp"
+#include "LightClusters.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
-#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <span>
+#include <streambuf>
 
 //-------------------------
 
@@ -71,6 +79,53 @@ glm::mat4x3 Scene::Transform::make_local_from_world() const {
 	}
 }
 
+void Scene::Transform::update_world_cache(uint32_t pass) const {
+	//already visited during this pass?
+	if (pass != 0 && cache.pass == pass) return;
+	cache.pass = pass;
+
+	//make sure the parent is up to date first (so its version reflects any changes):
+	if (parent) parent->update_world_cache(pass);
+
+	bool dirty = !cache.valid
+		|| cache.position != position
+		|| cache.rotation != rotation
+		|| cache.scale != scale
+		|| cache.parent != parent
+		|| (parent && cache.parent_version != parent->cache.version);
+	if (!dirty) return;
+
+	if (!parent) {
+		cache.world_from_local = make_parent_from_local();
+		cache.local_from_world = make_local_from_parent();
+	} else {
+		cache.world_from_local = parent->cache.world_from_local * glm::mat4(make_parent_from_local()); //note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
+		cache.local_from_world = make_local_from_parent() * glm::mat4(parent->cache.local_from_world);
+	}
+
+	cache.position = position;
+	cache.rotation = rotation;
+	cache.scale = scale;
+	cache.parent = parent;
+	cache.parent_version = (parent ? parent->cache.version : 0);
+	cache.version += 1;
+	cache.valid = true;
+}
+
+//-------------------------
+
+uint32_t Scene::update_world_transforms() const {
+	//each call gets a fresh (non-zero) pass number, so each transform is visited only once per call:
+	static uint32_t pass = 0;
+	pass += 1;
+	if (pass == 0) pass = 1;
+
+	for (auto const &transform : transforms) {
+		transform.update_world_cache(pass);
+	}
+	return pass;
+}
+
 //-------------------------
 
 glm::mat4 Scene::Camera::make_projection() const {
@@ -80,16 +135,355 @@ glm::mat4 Scene::Camera::make_projection() const {
 //-------------------------
 
 
-void Scene::draw(Camera const &camera) const {
+//-------------------------
+
+//helper for the Pipeline::set_uniform functions -- find slot for 'location' and store a value there:
+static void set_uniform_value(Scene::Drawable::Pipeline &pipeline, GLuint location, GLenum type, void const *value, size_t size) {
+	Scene::Drawable::Pipeline::Uniform *slot = nullptr;
+	for (auto &uniform : pipeline.uniforms) {
+		if (uniform.type != 0 && uniform.location == location) {
+			slot = &uniform;
+			break;
+		}
+		if (uniform.type == 0 && slot == nullptr) slot = &uniform;
+	}
+	if (slot == nullptr) {
+		throw std::runtime_error("Drawable pipeline already has " + std::to_string(Scene::Drawable::Pipeline::UniformCount) + " uniforms set.");
+	}
+	slot->location = location;
+	slot->type = type;
+	slot->value = { };
+	std::memcpy(&slot->value, value, size);
+}
+
+void Scene::Drawable::Pipeline::set_uniform(GLuint location, float value) {
+	set_uniform_value(*this, location, GL_FLOAT, &value, sizeof(value));
+}
+void Scene::Drawable::Pipeline::set_uniform(GLuint location, glm::vec2 const &value) {
+	set_uniform_value(*this, location, GL_FLOAT_VEC2, &value, sizeof(value));
+}
+void Scene::Drawable::Pipeline::set_uniform(GLuint location, glm::vec3 const &value) {
+	set_uniform_value(*this, location, GL_FLOAT_VEC3, &value, sizeof(value));
+}
+void Scene::Drawable::Pipeline::set_uniform(GLuint location, glm::vec4 const &value) {
+	set_uniform_value(*this, location, GL_FLOAT_VEC4, &value, sizeof(value));
+}
+void Scene::Drawable::Pipeline::set_uniform(GLuint location, GLint value) {
+	set_uniform_value(*this, location, GL_INT, &value, sizeof(value));
+}
+void Scene::Drawable::Pipeline::set_uniform(GLuint location, glm::ivec2 const &value) {
+	set_uniform_value(*this, location, GL_INT_VEC2, &value, sizeof(value));
+}
+void Scene::Drawable::Pipeline::set_uniform(GLuint location, glm::ivec3 const &value) {
+	set_uniform_value(*this, location, GL_INT_VEC3, &value, sizeof(value));
+}
+void Scene::Drawable::Pipeline::set_uniform(GLuint location, glm::ivec4 const &value) {
+	set_uniform_value(*this, location, GL_INT_VEC4, &value, sizeof(value));
+}
+
+//upload a uniform value to the currently bound program:
+static void upload_uniform(Scene::Drawable::Pipeline::Uniform const &uniform) {
+	switch (uniform.type) {
+		case GL_FLOAT: glUniform1fv(uniform.location, 1, uniform.value.f); break;
+		case GL_FLOAT_VEC2: glUniform2fv(uniform.location, 1, uniform.value.f); break;
+		case GL_FLOAT_VEC3: glUniform3fv(uniform.location, 1, uniform.value.f); break;
+		case GL_FLOAT_VEC4: glUniform4fv(uniform.location, 1, uniform.value.f); break;
+		case GL_INT: glUniform1iv(uniform.location, 1, uniform.value.i); break;
+		case GL_INT_VEC2: glUniform2iv(uniform.location, 1, uniform.value.i); break;
+		case GL_INT_VEC3: glUniform3iv(uniform.location, 1, uniform.value.i); break;
+		case GL_INT_VEC4: glUniform4iv(uniform.location, 1, uniform.value.i); break;
+		default: break;
+	}
+}
+
+static bool operator==(Scene::Drawable::Pipeline::Uniform const &a, Scene::Drawable::Pipeline::Uniform const &b) {
+	return a.location == b.location && a.type == b.type && std::memcmp(&a.value, &b.value, sizeof(a.value)) == 0;
+}
+
+//-------------------------
+
+//light data in the std140 layout of the Lights block:
+struct LightData {
+	glm::vec4 position; //xyz: light-space position, w: type (0: point, 1: hemisphere, 2: spot, 3: directional)
+	glm::vec4 direction; //xyz: light-space direction the light points, w: cosine of spot cutoff angle
+	glm::vec4 energy; //rgb: energy, a: fade-out distance (0: none)
+};
+static_assert(sizeof(LightData) == 3 * 16, "LightData matches std140 layout.");
+
+//data for all of the scene's lights, and their bounding spheres (world space; radius is infinite for lights that reach everything):
+static std::vector< LightData > light_data;
+static std::vector< glm::vec4 > light_spheres;
+
+//fill light_data and light_spheres for all of a scene's lights, and upload the first MaxLights to the Lights block:
+// ('pass' is the update pass from Scene::update_world_transforms())
+static void upload_lights(std::list< Scene::Light > const &lights, glm::mat4x3 const &light_from_world, uint32_t pass) {
+	light_data.clear();
+	light_spheres.clear();
+
+	for (auto const &light : lights) {
+		light.transform->update_world_cache(pass); //(returns immediately unless transform is outside the scene's transform list)
+		glm::mat4x3 const &world_from_light = light.transform->world_from_local();
+		glm::vec3 position = world_from_light[3];
+		glm::vec3 direction = -glm::normalize(world_from_light[2]); //lights point along their -z axis
+
+		float type = 0.0f;
+		if (light.type == Scene::Light::Point) type = 0.0f;
+		else if (light.type == Scene::Light::Hemisphere) type = 1.0f;
+		else if (light.type == Scene::Light::Spot) type = 2.0f;
+		else if (light.type == Scene::Light::Directional) type = 3.0f;
+
+		LightData &data = light_data.emplace_back();
+		data.position = glm::vec4(light_from_world * glm::vec4(position, 1.0f), type);
+		data.direction = glm::vec4(glm::normalize(glm::mat3(light_from_world) * direction), std::cos(0.5f * light.spot_fov));
+		data.energy = glm::vec4(light.energy, light.distance);
+
+		bool local = (light.type == Scene::Light::Point || light.type == Scene::Light::Spot) && light.distance > 0.0f;
+		light_spheres.emplace_back(position, local ? light.distance : std::numeric_limits< float >::infinity());
+	}
+
+	if (light_data.empty()) {
+		//default light: white-ish hemisphere light from above:
+		LightData &data = light_data.emplace_back();
+		data.position = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		data.direction = glm::vec4(glm::normalize(glm::mat3(light_from_world) * glm::vec3(0.0f, 0.0f, -1.0f)), 0.0f);
+		data.energy = glm::vec4(1.0f, 1.0f, 0.95f, 0.0f);
+		light_spheres.emplace_back(0.0f, 0.0f, 0.0f, std::numeric_limits< float >::infinity());
+	}
+
+	static GLuint lights_buffer = 0;
+	if (lights_buffer == 0) glGenBuffers(1, &lights_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, lights_buffer);
+	//(always allocate the full block size, since the shader declares MaxLights lights)
+	glBufferData(GL_UNIFORM_BUFFER, Scene::MaxLights * sizeof(LightData), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, std::min< size_t >(light_data.size(), Scene::MaxLights) * sizeof(LightData), light_data.data());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, Scene::LightsBinding, lights_buffer);
+}
+
+//pick the (up to MaxObjectLights) lights from light_spheres that reach a world-space box, preferring closer lights:
+// returns the number of lights picked
+static uint32_t select_lights(glm::vec3 const &center, glm::vec3 const &extent, GLint *indices) {
+	float distances[Scene::MaxObjectLights];
+	uint32_t count = 0;
+	//(only the first MaxLights lights are in the Lights block)
+	if (light_spheres.size() > Scene::MaxLights) {
+		static bool warned = false;
+		if (!warned) {
+			std::cerr << "WARNING: scene has more than " << Scene::MaxLights << " lights; extra lights will be ignored by programs without clustered lighting." << std::endl;
+			warned = true;
+		}
+	}
+	uint32_t light_count = std::min< uint32_t >(uint32_t(light_spheres.size()), Scene::MaxLights);
+	for (uint32_t l = 0; l < light_count; ++l) {
+		glm::vec4 const &sphere = light_spheres[l];
+		float dis2 = 0.0f; //(lights that reach everything sort first)
+		if (sphere.w != std::numeric_limits< float >::infinity()) {
+			//squared distance from sphere center to box:
+			glm::vec3 outside = glm::max(glm::abs(glm::vec3(sphere) - center) - extent, glm::vec3(0.0f));
+			dis2 = glm::dot(outside, outside);
+			if (dis2 > sphere.w * sphere.w) continue;
+		}
+		//insert into list sorted by distance, dropping the farthest light if full:
+		if (count == Scene::MaxObjectLights && dis2 >= distances[count-1]) continue;
+		uint32_t i = std::min(count, Scene::MaxObjectLights - 1);
+		while (i > 0 && distances[i-1] > dis2) {
+			distances[i] = distances[i-1];
+			indices[i] = indices[i-1];
+			--i;
+		}
+		distances[i] = dis2;
+		indices[i] = GLint(l);
+		count = std::min(count + 1, Scene::MaxObjectLights);
+	}
+	return count;
+}
+
+//assign lights to clusters and upload the results for programs with clustered lighting:
+// (must be called after upload_lights)
+// ('viewport' is the current glViewport, as x, y, width, height)
+static void upload_light_clusters(glm::mat4 const &clip_from_world, glm::ivec4 const &viewport) {
+	static LightClusters clusters;
+	clusters.build(clip_from_world, light_spheres);
+
+	//cluster lookup parameters, in the std140 layout of the Clusters block:
+	struct {
+		glm::uvec4 dims; //xyz: grid size, w: number of global lights
+		glm::vec4 scale; //see LightClusters::cell_scale
+		glm::vec4 origin; //xy: window position of the viewport's lower left corner
+	} params;
+	static_assert(sizeof(params) == 48, "Clusters block matches std140 layout.");
+
+	params.dims = glm::uvec4(clusters.dims, clusters.global_count);
+	params.scale = clusters.cell_scale(glm::uvec2(glm::max(glm::ivec2(viewport.z, viewport.w), glm::ivec2(0))));
+	params.origin = glm::vec4(viewport.x, viewport.y, 0.0f, 0.0f);
+
+	static GLuint params_buffer = 0;
+	if (params_buffer == 0) glGenBuffers(1, &params_buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, params_buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(params), &params, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, Scene::ClustersBinding, params_buffer);
+
+	//light data, cells, and light lists go in texture buffers (they are too big for uniform blocks):
+	struct TextureBuffer {
+		GLuint buffer = 0;
+		GLuint texture = 0;
+		void upload(GLenum format, void const *data, size_t size) {
+			if (buffer == 0) {
+				glGenBuffers(1, &buffer);
+				glGenTextures(1, &texture);
+			}
+			glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+			//(GL requires a non-empty buffer for texelFetch to be well-defined, so always upload something)
+			static uint32_t const zeros[4] = {0, 0, 0, 0};
+			if (size == 0) {
+				data = zeros;
+				size = sizeof(zeros);
+			}
+			glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+			glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+			glBindTexture(GL_TEXTURE_BUFFER, texture);
+			glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+		}
+	};
+	static TextureBuffer light_data_tb, cells_tb, lights_tb;
+
+	glActiveTexture(GL_TEXTURE0 + Scene::ClusterTextureUnit + 0);
+	light_data_tb.upload(GL_RGBA32F, light_data.data(), light_data.size() * sizeof(LightData));
+	glActiveTexture(GL_TEXTURE0 + Scene::ClusterTextureUnit + 1);
+	cells_tb.upload(GL_RG32UI, clusters.cells.data(), clusters.cells.size() * sizeof(clusters.cells[0]));
+	glActiveTexture(GL_TEXTURE0 + Scene::ClusterTextureUnit + 2);
+	lights_tb.upload(GL_R32UI, clusters.indices.data(), clusters.indices.size() * sizeof(clusters.indices[0]));
+	glActiveTexture(GL_TEXTURE0);
+}
+
+//-------------------------
+
+//can a drawable be drawn as part of an instanced batch?
+static bool is_instanceable(Scene::Drawable::Pipeline const &pipeline) {
+	//(set_uniforms might set per-drawable uniforms, so drawables that use it must be drawn alone)
+	if (pipeline.instanced.program == 0 || pipeline.instanced.vao == 0 || pipeline.set_uniforms) return false;
+	//(uniform locations refer to 'program', not the instanced program, so drawables with uniforms are drawn alone as well)
+	for (auto const &uniform : pipeline.uniforms) {
+		if (uniform.type != 0) return false;
+	}
+	return true;
+}
+
+//can two (instanceable) drawables be drawn in the same instanced batch?
+static bool same_instanced_state(Scene::Drawable::Pipeline const &a, Scene::Drawable::Pipeline const &b) {
+	if (a.program != b.program || a.vao != b.vao) return false;
+	if (a.instanced.program != b.instanced.program || a.instanced.vao != b.instanced.vao) return false;
+	if (a.type != b.type || a.start != b.start || a.count != b.count) return false;
+	if (a.index_count != b.index_count || (a.index_count != 0 && (a.index_type != b.index_type || a.index_start != b.index_start))) return false;
+	if (a.position_offset != b.position_offset || a.position_scale != b.position_scale) return false;
+	for (uint32_t i = 0; i < Scene::Drawable::Pipeline::TextureCount; ++i) {
+		if (a.textures[i].texture != b.textures[i].texture) return false;
+		if (a.textures[i].texture != 0 && a.textures[i].target != b.textures[i].target) return false;
+	}
+	return true;
+}
+
+//vertex (and index) range to draw for a drawable at a level of detail:
+// (level zero is the pipeline's own mesh, level l is drawable.lods[l-1])
+struct MeshRange {
+	GLuint start, count;
+	GLuint index_start, index_count; //(zero index_count means "not indexed")
+	bool operator==(MeshRange const &) const = default;
+};
+static MeshRange mesh_range(Scene::Drawable const &drawable, uint32_t lod) {
+	Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
+	if (lod == 0) return MeshRange{pipeline.start, pipeline.count, pipeline.index_start, pipeline.index_count};
+	Scene::Drawable::LOD const &level = drawable.lods[lod - 1];
+	return MeshRange{level.start, level.count, 0, 0};
+}
+
+//triangles in a range (for DrawStats):
+static uint64_t triangle_count(GLenum type, MeshRange const &range) {
+	GLuint count = (range.index_count != 0 ? range.index_count : range.count);
+	if (type == GL_TRIANGLES) return count / 3;
+	if (type == GL_TRIANGLE_STRIP || type == GL_TRIANGLE_FAN) return count >= 3 ? count - 2 : 0;
+	return 0;
+}
+
+//issue the draw call for a range of a pipeline's mesh:
+// ('instances' of zero means a plain, non-instanced, draw)
+static void draw_mesh(Scene::Drawable::Pipeline const &pipeline, MeshRange const &range, GLsizei instances) {
+	if (range.index_count != 0) {
+		GLbyte const *first = (GLbyte const *)0 + size_t(range.index_start) * (pipeline.index_type == GL_UNSIGNED_SHORT ? 2 : 4);
+		if (instances) {
+			glDrawElementsInstancedBaseVertex(pipeline.type, range.index_count, pipeline.index_type, first, instances, range.start);
+		} else {
+			glDrawElementsBaseVertex(pipeline.type, range.index_count, pipeline.index_type, first, range.start);
+		}
+	} else {
+		if (instances) {
+			glDrawArraysInstanced(pipeline.type, range.start, range.count, instances);
+		} else {
+			glDrawArrays(pipeline.type, range.start, range.count);
+		}
+	}
+}
+
+//Sort keys for the render queue pack (from most to least significant):
+// program [12 bits], vertex array [16 bits], textures [16 bits], depth or mesh [20 bits]
+//Names that don't fit are truncated, which only makes grouping less effective; actual state is always compared before being skipped.
+static uint64_t make_sort_key(Scene::Drawable::Pipeline const &pipeline, MeshRange const &range, float depth) {
+	uint64_t program = pipeline.program & 0xfff;
+	uint64_t vao = pipeline.vao & 0xffff;
+	uint64_t textures = 0;
+	for (uint32_t i = 0; i < Scene::Drawable::Pipeline::TextureCount; ++i) {
+		textures ^= uint64_t(pipeline.textures[i].texture) << (4 * i);
+	}
+	textures &= 0xffff;
+	uint64_t low;
+	if (is_instanceable(pipeline)) {
+		//instanceable drawables are sorted by mesh, so copies of the same mesh end up adjacent:
+		low = (uint64_t(range.start) * 4099 + range.count + uint64_t(range.index_start) * 31) & 0xfffff;
+	} else {
+		//non-negative floats sort the same as their bit patterns, so keep the top 20 (non-sign) bits:
+		// (this sorts front-to-back within a group, which helps early depth testing)
+		depth = std::max(depth, 0.0f);
+		uint32_t depth_bits;
+		std::memcpy(&depth_bits, &depth, sizeof(depth_bits));
+		low = depth_bits >> 11;
+	}
+	return (program << 52) | (vao << 36) | (textures << 20) | low;
+}
+
+void Scene::draw(Camera const &camera, glm::ivec4 const &viewport, DrawStats *stats) const {
 	assert(camera.transform);
-	glm::mat4 clip_from_world = camera.make_projection() * glm::mat4(camera.transform->make_local_from_world());
+	camera.transform->update_world_cache();
+	glm::mat4 clip_from_world = camera.make_projection() * glm::mat4(camera.transform->local_from_world());
 	glm::mat4x3 light_from_world = glm::mat4x3(1.0f);
-	draw(clip_from_world, light_from_world);
+	draw(clip_from_world, viewport, light_from_world, stats);
 }
 
-void Scene::draw(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from_world) const {
+void Scene::draw(glm::mat4 const &clip_from_world, glm::ivec4 const &viewport, glm::mat4x3 const &light_from_world, DrawStats *stats) const {
+
+	//bring cached world matrices up to date (once per transform):
+	uint32_t pass = update_world_transforms();
+
+	//--- frustum culling ---
+
+	//world-space bounding boxes of drawables that might be drawn, stored as separate arrays so the plane tests vectorize:
+	// (static so the storage is reused from frame to frame)
+	static struct {
+		std::vector< Drawable const * > drawables;
+		std::vector< float > cx, cy, cz; //box centers
+		std::vector< float > ex, ey, ez; //box half-extents
+		std::vector< float > sx, sy, sz, r; //bounding sphere centers and radii
+		std::vector< uint8_t > visible;
+		std::vector< uint8_t > lod; //selected level of detail (see mesh_range)
+	} boxes;
+
+	boxes.drawables.clear();
+	boxes.cx.clear(); boxes.cy.clear(); boxes.cz.clear();
+	boxes.ex.clear(); boxes.ey.clear(); boxes.ez.clear();
+	boxes.sx.clear(); boxes.sy.clear(); boxes.sz.clear(); boxes.r.clear();
 
-	//Iterate through all drawables, sending each one to OpenGL:
 	for (auto const &drawable : drawables) {
 		//Reference to drawable's pipeline for convenience:
 		Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
@@ -101,78 +495,497 @@ void Scene::draw(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from
 		//skip any drawables that don't contain any vertices:
 		if (pipeline.count == 0) continue;
 
+		assert(drawable.transform); //drawables *must* have a transform
+		drawable.transform->update_world_cache(pass); //(returns immediately unless transform is outside this scene's transform list)
+
+		glm::vec3 center, extent;
+		if (drawable.has_bounds()) {
+			//transform box to world space (giving a box that contains the transformed box):
+			glm::mat4x3 const &world_from_object = drawable.transform->world_from_local();
+			glm::vec3 local_center = 0.5f * (drawable.max + drawable.min);
+			glm::vec3 local_extent = 0.5f * (drawable.max - drawable.min);
+			center = world_from_object * glm::vec4(local_center, 1.0f);
+			extent = glm::abs(world_from_object[0]) * local_extent.x
+			       + glm::abs(world_from_object[1]) * local_extent.y
+			       + glm::abs(world_from_object[2]) * local_extent.z;
+		} else {
+			//no bounds, so use a box that will never be outside of any plane:
+			// (centered on the transform's origin, since the center is also used for depth sorting)
+			center = drawable.transform->world_from_local()[3];
+			extent = glm::vec3(std::numeric_limits< float >::max());
+		}
+
+		glm::vec3 sphere_center;
+		float sphere_radius;
+		if (drawable.has_sphere()) {
+			//transform sphere to world space (radius grows by the largest axis scale):
+			glm::mat4x3 const &world_from_object = drawable.transform->world_from_local();
+			sphere_center = world_from_object * glm::vec4(drawable.center, 1.0f);
+			sphere_radius = drawable.radius * std::sqrt(std::max({
+				glm::dot(world_from_object[0], world_from_object[0]),
+				glm::dot(world_from_object[1], world_from_object[1]),
+				glm::dot(world_from_object[2], world_from_object[2])
+			}));
+		} else {
+			//no sphere, so use one that will never be outside of any plane:
+			sphere_center = center;
+			sphere_radius = std::numeric_limits< float >::max();
+		}
 
-		//Set shader program:
-		glUseProgram(pipeline.program);
+		boxes.drawables.emplace_back(&drawable);
+		boxes.cx.emplace_back(center.x); boxes.cy.emplace_back(center.y); boxes.cz.emplace_back(center.z);
+		boxes.ex.emplace_back(extent.x); boxes.ey.emplace_back(extent.y); boxes.ez.emplace_back(extent.z);
+		boxes.sx.emplace_back(sphere_center.x); boxes.sy.emplace_back(sphere_center.y); boxes.sz.emplace_back(sphere_center.z);
+		boxes.r.emplace_back(sphere_radius);
+	}
 
-		//Set attribute sources:
-		glBindVertexArray(pipeline.vao);
+	{ //test boxes and spheres against frustum planes:
+		//planes (as a*x + b*y + c*z + d >= 0 for points inside) are sums/differences of rows of clip_from_world:
+		// (note: with an infinite projection the far plane comes out as 0*x + 0*y + 0*z + d with d > 0, which culls nothing)
+		glm::vec4 row_x = glm::vec4(clip_from_world[0][0], clip_from_world[1][0], clip_from_world[2][0], clip_from_world[3][0]);
+		glm::vec4 row_y = glm::vec4(clip_from_world[0][1], clip_from_world[1][1], clip_from_world[2][1], clip_from_world[3][1]);
+		glm::vec4 row_z = glm::vec4(clip_from_world[0][2], clip_from_world[1][2], clip_from_world[2][2], clip_from_world[3][2]);
+		glm::vec4 row_w = glm::vec4(clip_from_world[0][3], clip_from_world[1][3], clip_from_world[2][3], clip_from_world[3][3]);
+		glm::vec4 planes[6] = {
+			row_w + row_x, row_w - row_x,
+			row_w + row_y, row_w - row_y,
+			row_w + row_z, row_w - row_z,
+		};
+
+		uint32_t count = uint32_t(boxes.drawables.size());
+		boxes.visible.assign(count, 1);
+		float const *cx = boxes.cx.data(), *cy = boxes.cy.data(), *cz = boxes.cz.data();
+		float const *ex = boxes.ex.data(), *ey = boxes.ey.data(), *ez = boxes.ez.data();
+		float const *sx = boxes.sx.data(), *sy = boxes.sy.data(), *sz = boxes.sz.data(), *r = boxes.r.data();
+		uint8_t *visible = boxes.visible.data();
+		for (glm::vec4 const &plane : planes) {
+			float a = plane.x, b = plane.y, c = plane.z, d = plane.w;
+			float abs_a = std::abs(a), abs_b = std::abs(b), abs_c = std::abs(c);
+			float len = std::sqrt(a * a + b * b + c * c); //(planes aren't normalized)
+			//box is outside if even its most-inside corner is behind the plane:
+			//sphere is outside if its center is more than its radius behind the plane:
+			// (the drawable is culled if either is outside, since both contain all of its vertices)
+			for (uint32_t i = 0; i < count; ++i) {
+				float box_dist = a * cx[i] + b * cy[i] + c * cz[i] + d
+				               + abs_a * ex[i] + abs_b * ey[i] + abs_c * ez[i];
+				float sphere_dist = a * sx[i] + b * sy[i] + c * sz[i] + d + len * r[i];
+				visible[i] &= uint8_t(box_dist >= 0.0f) & uint8_t(sphere_dist >= 0.0f);
+			}
+		}
+	}
 
-		//Configure program uniforms:
+	//--- sorting ---
 
-		//the object-to-world matrix is used in all three of these uniforms:
-		assert(drawable.transform); //drawables *must* have a transform
-		glm::mat4x3 world_from_object = drawable.transform->make_world_from_local();
+	DrawStats local_stats;
+
+	//visible drawables are put in a queue and sorted to group together draws that share OpenGL state:
+	// (static so the storage is reused from frame to frame)
+	static std::vector< std::pair< uint64_t, uint32_t > > queue; //(sort key, index in boxes)
+	queue.clear();
+
+	{
+		glm::vec4 row_w = glm::vec4(clip_from_world[0][3], clip_from_world[1][3], clip_from_world[2][3], clip_from_world[3][3]);
+		//clip y per unit of world-space length (for projections without shear):
+		float y_scale = glm::length(glm::vec3(clip_from_world[0][1], clip_from_world[1][1], clip_from_world[2][1]));
+		boxes.lod.assign(boxes.drawables.size(), 0);
+		for (uint32_t b = 0; b < boxes.drawables.size(); ++b) {
+			if (!boxes.visible[b]) {
+				local_stats.culled += 1;
+				continue;
+			}
+			Drawable const &drawable = *boxes.drawables[b];
+			//clip w is distance along the view direction (for perspective projections):
+			float depth = glm::dot(row_w, glm::vec4(boxes.cx[b], boxes.cy[b], boxes.cz[b], 1.0f));
+
+			//pick a level of detail by the fraction of the screen height covered by the drawable's bounding sphere:
+			// (the same sphere pnct-tool used to compute max_screen_size; falls back to the world-space box's circumsphere)
+			if (drawable.lod_count > 0 && (drawable.has_sphere() || drawable.has_bounds())) {
+				float radius, sphere_depth;
+				if (drawable.has_sphere()) {
+					radius = boxes.r[b];
+					sphere_depth = glm::dot(row_w, glm::vec4(boxes.sx[b], boxes.sy[b], boxes.sz[b], 1.0f));
+				} else {
+					radius = glm::length(glm::vec3(boxes.ex[b], boxes.ey[b], boxes.ez[b]));
+					sphere_depth = depth;
+				}
+				if (sphere_depth > radius) { //(otherwise the camera is inside the sphere)
+					float screen_size = radius * y_scale / sphere_depth;
+					uint32_t lod_count = std::min< uint32_t >(drawable.lod_count, Drawable::MaxLODs);
+					for (uint32_t l = 0; l < lod_count && screen_size <= drawable.lods[l].max_screen_size; ++l) {
+						boxes.lod[b] = uint8_t(l + 1);
+					}
+				}
+			}
 
-		//CLIP_FROM_OBJECT takes vertices from object space to clip space:
-		if (pipeline.CLIP_FROM_OBJECT_mat4 != -1U) {
-			glm::mat4 clip_from_object = clip_from_world * glm::mat4(world_from_object);
-			glUniformMatrix4fv(pipeline.CLIP_FROM_OBJECT_mat4, 1, GL_FALSE, glm::value_ptr(clip_from_object));
+			queue.emplace_back(make_sort_key(drawable.pipeline, mesh_range(drawable, boxes.lod[b]), depth), b);
 		}
+	}
+
+	std::sort(queue.begin(), queue.end());
 
-		//the object-to-light matrix is used in the next two uniforms:
-		glm::mat4x3 light_from_object = light_from_world * glm::mat4(world_from_object);
+	//--- batching ---
 
-		//CLIP_FROM_OBJECT takes vertices from object space to light space:
-		if (pipeline.LIGHT_FROM_OBJECT_mat4x3 != -1U) {
-			glUniformMatrix4x3fv(pipeline.LIGHT_FROM_OBJECT_mat4x3, 1, GL_FALSE, glm::value_ptr(light_from_object));
+	//runs of queue items with identical instanceable state are drawn as one instanced batch:
+	struct Batch {
+		uint32_t begin, end; //range in queue
+		uint32_t instances = -1U; //index of first world matrix in instance data, or -1U if not instanced
+		uint32_t object_matrices = -1U; //slot in object matrices data, or -1U if not using OBJECT_MATRICES_block
+	};
+	static std::vector< Batch > batches;
+	static std::vector< glm::mat4x3 > instance_data;
+	batches.clear();
+	instance_data.clear();
+
+	//per-object matrices in the std140 layout of the ObjectMatrices block:
+	struct ObjectMatrices {
+		glm::mat4 CLIP_FROM_OBJECT;
+		glm::vec4 LIGHT_FROM_OBJECT[4]; //(std140 pads mat4x3 columns to vec4)
+		glm::vec4 LIGHT_FROM_NORMAL[3]; //(std140 pads mat3 columns to vec4)
+	};
+	static_assert(sizeof(ObjectMatrices) == 64 + 64 + 48, "ObjectMatrices matches std140 layout.");
+
+	//slots are padded to the uniform buffer offset alignment so glBindBufferRange can select them:
+	static size_t object_matrices_stride = 0;
+	if (object_matrices_stride == 0) {
+		GLint alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		alignment = std::max(alignment, 1);
+		object_matrices_stride = (sizeof(ObjectMatrices) + alignment - 1) / alignment * alignment;
+	}
+	static std::vector< uint8_t > object_matrices_data;
+	uint32_t object_matrices_slots = 0;
+
+	bool any_clustered = false;
+
+	for (uint32_t begin = 0; begin < queue.size(); /* later */) {
+		Drawable::Pipeline const &pipeline = boxes.drawables[queue[begin].second]->pipeline;
+		any_clustered = any_clustered || pipeline.clustered_lights;
+		uint32_t end = begin + 1;
+		if (is_instanceable(pipeline)) {
+			MeshRange range = mesh_range(*boxes.drawables[queue[begin].second], boxes.lod[queue[begin].second]);
+			while (end < queue.size() && same_instanced_state(pipeline, boxes.drawables[queue[end].second]->pipeline)
+			                          && mesh_range(*boxes.drawables[queue[end].second], boxes.lod[queue[end].second]) == range) {
+				++end;
+			}
 		}
+		Batch &batch = batches.emplace_back(Batch{begin, end});
+		if (end - begin > 1) {
+			batch.instances = uint32_t(instance_data.size());
+			for (uint32_t i = begin; i < end; ++i) {
+				instance_data.emplace_back(boxes.drawables[queue[i].second]->transform->world_from_local());
+			}
+		} else if (pipeline.OBJECT_MATRICES_block != -1U) {
+			batch.object_matrices = object_matrices_slots++;
+			if (object_matrices_data.size() < object_matrices_slots * object_matrices_stride) {
+				object_matrices_data.resize(object_matrices_slots * object_matrices_stride);
+			}
 
-		//LIGHT_FROM_NORMAL takes normals from object space to light space:
-		if (pipeline.LIGHT_FROM_NORMAL_mat3 != -1U) {
+			glm::mat4x3 const &world_from_object = boxes.drawables[queue[begin].second]->transform->world_from_local();
+			glm::mat4x3 light_from_object = light_from_world * glm::mat4(world_from_object);
 			glm::mat3 light_from_normal = glm::inverse(glm::transpose(glm::mat3(light_from_object)));
-			glUniformMatrix3fv(pipeline.LIGHT_FROM_NORMAL_mat3, 1, GL_FALSE, glm::value_ptr(light_from_normal));
+
+			ObjectMatrices matrices;
+			matrices.CLIP_FROM_OBJECT = clip_from_world * glm::mat4(world_from_object);
+			for (uint32_t c = 0; c < 4; ++c) matrices.LIGHT_FROM_OBJECT[c] = glm::vec4(light_from_object[c], 0.0f);
+			for (uint32_t c = 0; c < 3; ++c) matrices.LIGHT_FROM_NORMAL[c] = glm::vec4(light_from_normal[c], 0.0f);
+			std::memcpy(object_matrices_data.data() + batch.object_matrices * object_matrices_stride, &matrices, sizeof(matrices));
 		}
+		begin = end;
+	}
 
-		//set any requested custom uniforms:
-		if (pipeline.set_uniforms) pipeline.set_uniforms();
+	//upload instance data (buffer is shared by all scenes and orphaned each time):
+	static GLuint instance_buffer = 0;
+	if (!instance_data.empty()) {
+		if (instance_buffer == 0) glGenBuffers(1, &instance_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+		glBufferData(GL_ARRAY_BUFFER, instance_data.size() * sizeof(instance_data[0]), instance_data.data(), GL_STREAM_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
 
-		//set up textures:
+	//upload object matrices (buffer is shared by all scenes; it is only re-allocated when it needs to grow, and orphaned otherwise):
+	static GLuint object_matrices_buffer = 0;
+	static size_t object_matrices_capacity = 0;
+	if (object_matrices_slots != 0) {
+		if (object_matrices_buffer == 0) glGenBuffers(1, &object_matrices_buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, object_matrices_buffer);
+		object_matrices_capacity = std::max(object_matrices_capacity, object_matrices_data.size());
+		glBufferData(GL_UNIFORM_BUFFER, object_matrices_capacity, nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, object_matrices_slots * object_matrices_stride, object_matrices_data.data());
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	//--- drawing ---
+
+	upload_lights(lights, light_from_world, pass);
+	if (any_clustered) upload_light_clusters(clip_from_world, viewport);
+
+	//pick lights for the drawables in queue[begin,end) and set them in the currently bound program:
+	auto set_object_lights = [&](uint32_t begin, uint32_t end, GLuint OBJECT_LIGHT_COUNT_int, GLuint OBJECT_LIGHTS_int_array) {
+		if (OBJECT_LIGHT_COUNT_int == -1U) return;
+		//bounding box of all the drawables:
+		glm::vec3 min = glm::vec3( std::numeric_limits< float >::max());
+		glm::vec3 max = glm::vec3(-std::numeric_limits< float >::max());
+		for (uint32_t i = begin; i < end; ++i) {
+			uint32_t b = queue[i].second;
+			glm::vec3 center = glm::vec3(boxes.cx[b], boxes.cy[b], boxes.cz[b]);
+			glm::vec3 extent = glm::vec3(boxes.ex[b], boxes.ey[b], boxes.ez[b]);
+			min = glm::min(min, center - extent);
+			max = glm::max(max, center + extent);
+		}
+		GLint indices[MaxObjectLights];
+		uint32_t count = select_lights(0.5f * (max + min), 0.5f * (max - min), indices);
+		glUniform1i(OBJECT_LIGHT_COUNT_int, GLint(count));
+		if (count > 0 && OBJECT_LIGHTS_int_array != -1U) {
+			glUniform1iv(OBJECT_LIGHTS_int_array, count, indices);
+		}
+	};
+
+	//current OpenGL state, used to skip redundant binds:
+	// (this assumes no program, vertex array, or textures are bound when draw() is called -- and leaves things that way)
+	GLuint bound_program = 0;
+	GLuint bound_vao = 0;
+	Drawable::Pipeline::TextureInfo bound_textures[Drawable::Pipeline::TextureCount];
+	uint32_t active_texture = 0;
+	//uniform values most recently uploaded (by slot) and the program they were uploaded to:
+	Drawable::Pipeline::Uniform uniforms_uploaded[Drawable::Pipeline::UniformCount];
+	GLuint uniforms_program = 0;
+
+	auto set_program = [&](GLuint program) {
+		if (bound_program != program) {
+			glUseProgram(program);
+			bound_program = program;
+			local_stats.state_changes += 1;
+		}
+	};
+	auto set_vao = [&](GLuint vao) {
+		if (bound_vao != vao) {
+			glBindVertexArray(vao);
+			bound_vao = vao;
+			local_stats.state_changes += 1;
+		}
+	};
+	auto set_active_texture = [&](uint32_t i) {
+		if (active_texture != i) {
+			glActiveTexture(GL_TEXTURE0 + i);
+			active_texture = i;
+		}
+	};
+	//(units the drawable doesn't use are left empty, as if textures were unbound after every draw)
+	auto set_textures = [&](Drawable::Pipeline const &pipeline) {
 		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, pipeline.textures[i].texture);
+			Drawable::Pipeline::TextureInfo const &want = pipeline.textures[i];
+			Drawable::Pipeline::TextureInfo &have = bound_textures[i];
+			if (want.texture == have.texture && (want.texture == 0 || want.target == have.target)) continue;
+
+			set_active_texture(i);
+			//un-bind old texture if it is on a different target (or if the unit should be empty):
+			if (have.texture != 0 && (want.texture == 0 || want.target != have.target)) {
+				glBindTexture(have.target, 0);
+				have.texture = 0;
+			}
+			if (want.texture != 0) {
+				glBindTexture(want.target, want.texture);
+				have = want;
 			}
+			local_stats.state_changes += 1;
 		}
+	};
 
-		//draw the object:
-		glDrawArrays(pipeline.type, pipeline.start, pipeline.count);
+	for (Batch const &batch : batches) {
+		local_stats.drawn += batch.end - batch.begin;
+		local_stats.draw_calls += 1;
 
-		//un-bind textures:
-		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, 0);
+		//(every drawable in a batch draws the same range)
+		Drawable const &first = *boxes.drawables[queue[batch.begin].second];
+		MeshRange range = mesh_range(first, boxes.lod[queue[batch.begin].second]);
+		local_stats.triangles += triangle_count(first.pipeline.type, range) * (batch.end - batch.begin);
+		local_stats.full_detail_triangles += triangle_count(first.pipeline.type, mesh_range(first, 0)) * (batch.end - batch.begin);
+
+		if (batch.instances != -1U) {
+			//--- instanced batch ---
+			Scene::Drawable::Pipeline const &pipeline = boxes.drawables[queue[batch.begin].second]->pipeline;
+			Scene::Drawable::Pipeline::Instanced const &instanced = pipeline.instanced;
+
+			set_program(instanced.program);
+			set_vao(instanced.vao);
+
+			if (instanced.CLIP_FROM_WORLD_mat4 != -1U) {
+				glUniformMatrix4fv(instanced.CLIP_FROM_WORLD_mat4, 1, GL_FALSE, glm::value_ptr(clip_from_world));
+			}
+			if (instanced.LIGHT_FROM_WORLD_mat4x3 != -1U) {
+				glUniformMatrix4x3fv(instanced.LIGHT_FROM_WORLD_mat4x3, 1, GL_FALSE, glm::value_ptr(light_from_world));
+			}
+			set_object_lights(batch.begin, batch.end, instanced.OBJECT_LIGHT_COUNT_int, instanced.OBJECT_LIGHTS_int_array);
+			if (instanced.POSITION_OFFSET_vec3 != -1U) {
+				glUniform3fv(instanced.POSITION_OFFSET_vec3, 1, glm::value_ptr(pipeline.position_offset));
+			}
+			if (instanced.POSITION_SCALE_vec3 != -1U) {
+				glUniform3fv(instanced.POSITION_SCALE_vec3, 1, glm::value_ptr(pipeline.position_scale));
+			}
+
+			//point the per-instance attribute at this batch's matrices:
+			// (GL 3.3 has no base instance parameter, so this re-specifies the pointer for each batch)
+			if (instanced.WORLD_FROM_OBJECT_mat4x3 != -1U) {
+				glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+				for (GLuint c = 0; c < 4; ++c) {
+					glVertexAttribPointer(instanced.WORLD_FROM_OBJECT_mat4x3 + c, 3, GL_FLOAT, GL_FALSE, sizeof(glm::mat4x3),
+						(GLbyte *)0 + batch.instances * sizeof(glm::mat4x3) + c * sizeof(glm::vec3));
+				}
+				glBindBuffer(GL_ARRAY_BUFFER, 0);
 			}
+
+			set_textures(pipeline);
+
+			draw_mesh(pipeline, range, batch.end - batch.begin);
+
+			continue;
 		}
-		glActiveTexture(GL_TEXTURE0);
 
+		//--- single drawable ---
+		assert(batch.end == batch.begin + 1);
+		Drawable const &drawable = *boxes.drawables[queue[batch.begin].second];
+
+		//Reference to drawable's pipeline for convenience:
+		Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
+
+		//Set shader program:
+		set_program(pipeline.program);
+
+		//Set attribute sources:
+		set_vao(pipeline.vao);
+
+		//Configure program uniforms:
+
+		if (batch.object_matrices != -1U) {
+			//matrices were already uploaded; just select this drawable's slot:
+			// (the per-object matrix uniforms are ignored in this case)
+			glBindBufferRange(GL_UNIFORM_BUFFER, ObjectMatricesBinding, object_matrices_buffer,
+				batch.object_matrices * object_matrices_stride, sizeof(ObjectMatrices));
+		} else {
+			//the object-to-world matrix is used in all three of these uniforms:
+			glm::mat4x3 const &world_from_object = drawable.transform->world_from_local();
+
+			//CLIP_FROM_OBJECT takes vertices from object space to clip space:
+			if (pipeline.CLIP_FROM_OBJECT_mat4 != -1U) {
+				glm::mat4 clip_from_object = clip_from_world * glm::mat4(world_from_object);
+				glUniformMatrix4fv(pipeline.CLIP_FROM_OBJECT_mat4, 1, GL_FALSE, glm::value_ptr(clip_from_object));
+			}
+
+			//the object-to-light matrix is used in the next two uniforms:
+			glm::mat4x3 light_from_object = light_from_world * glm::mat4(world_from_object);
+
+			//CLIP_FROM_OBJECT takes vertices from object space to light space:
+			if (pipeline.LIGHT_FROM_OBJECT_mat4x3 != -1U) {
+				glUniformMatrix4x3fv(pipeline.LIGHT_FROM_OBJECT_mat4x3, 1, GL_FALSE, glm::value_ptr(light_from_object));
+			}
+
+			//LIGHT_FROM_NORMAL takes normals from object space to light space:
+			if (pipeline.LIGHT_FROM_NORMAL_mat3 != -1U) {
+				glm::mat3 light_from_normal = glm::inverse(glm::transpose(glm::mat3(light_from_object)));
+				glUniformMatrix3fv(pipeline.LIGHT_FROM_NORMAL_mat3, 1, GL_FALSE, glm::value_ptr(light_from_normal));
+			}
+		}
+
+		//dequantization parameters for quantized meshes:
+		if (pipeline.POSITION_OFFSET_vec3 != -1U) {
+			glUniform3fv(pipeline.POSITION_OFFSET_vec3, 1, glm::value_ptr(pipeline.position_offset));
+		}
+		if (pipeline.POSITION_SCALE_vec3 != -1U) {
+			glUniform3fv(pipeline.POSITION_SCALE_vec3, 1, glm::value_ptr(pipeline.position_scale));
+		}
+
+		//lights that reach this drawable:
+		set_object_lights(batch.begin, batch.end, pipeline.OBJECT_LIGHT_COUNT_int, pipeline.OBJECT_LIGHTS_int_array);
+
+		//set per-drawable uniforms (skipping values already uploaded to this program):
+		if (uniforms_program != pipeline.program) {
+			for (auto &uploaded : uniforms_uploaded) {
+				uploaded.type = 0;
+			}
+			uniforms_program = pipeline.program;
+		}
+		for (uint32_t u = 0; u < Drawable::Pipeline::UniformCount; ++u) {
+			Drawable::Pipeline::Uniform const &uniform = pipeline.uniforms[u];
+			if (uniform.type == 0) continue;
+			if (uniforms_uploaded[u] == uniform) continue;
+			upload_uniform(uniform);
+			//(another slot's record may refer to the same location, and is now out of date)
+			for (auto &uploaded : uniforms_uploaded) {
+				if (uploaded.location == uniform.location) uploaded.type = 0;
+			}
+			uniforms_uploaded[u] = uniform;
+		}
+
+		//set any requested custom uniforms:
+		if (pipeline.set_uniforms) {
+			pipeline.set_uniforms();
+			uniforms_program = 0; //(could have changed anything)
+		}
+
+		//set up textures:
+		set_textures(pipeline);
+
+		//draw the object:
+		draw_mesh(pipeline, range, 0);
+	}
+
+	//un-bind textures:
+	for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
+		if (bound_textures[i].texture != 0) {
+			set_active_texture(i);
+			glBindTexture(bound_textures[i].target, 0);
+		}
+	}
+	set_active_texture(0);
+
+	if (object_matrices_slots != 0) {
+		glBindBufferBase(GL_UNIFORM_BUFFER, ObjectMatricesBinding, 0);
+	}
+	glBindBufferBase(GL_UNIFORM_BUFFER, LightsBinding, 0);
+	if (any_clustered) {
+		glBindBufferBase(GL_UNIFORM_BUFFER, ClustersBinding, 0);
+		for (uint32_t i = 0; i < 3; ++i) {
+			glActiveTexture(GL_TEXTURE0 + ClusterTextureUnit + i);
+			glBindTexture(GL_TEXTURE_BUFFER, 0);
+		}
+		glActiveTexture(GL_TEXTURE0);
 	}
 
 	glUseProgram(0);
 	glBindVertexArray(0);
 
 	GL_ERRORS();
+
+	if (stats) *stats = local_stats;
 }
 
 
+//read-only stream buffer over a range of memory (used to hand the end of a mapped scene file to load_extra):
+struct MemoryStreamBuf : std::streambuf {
+	MemoryStreamBuf(char const *begin, char const *end) {
+		//(streambuf only reads through its get area, so it's fine to point it at const data)
+		setg(const_cast< char * >(begin), const_cast< char * >(begin), const_cast< char * >(end));
+	}
+	//support tellg/seekg:
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+		if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+		off_type base = (dir == std::ios_base::beg ? 0 : dir == std::ios_base::cur ? gptr() - eback() : egptr() - eback());
+		if (base + off < 0 || base + off > egptr() - eback()) return pos_type(off_type(-1));
+		setg(eback(), eback() + base + off, egptr());
+		return pos_type(base + off);
+	}
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+		return seekoff(off_type(pos), std::ios_base::beg, which);
+	}
+};
+
 void Scene::load(std::string const &filename,
-	std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) {
+	std::function< void(Scene &, Transform *, std::string_view) > const &on_drawable) {
 
-	std::ifstream file(filename, std::ios::binary);
+	//the file is mapped, so chunks can be viewed (in any order) without being copied:
+	ChunkFile file(filename);
 
-	std::vector< char > names;
-	read_chunk(file, "str0", &names);
+	std::span< char const > names = file.view< char >("str0");
 
 	struct HierarchyEntry {
 		uint32_t parent;
@@ -183,8 +996,8 @@ void Scene::load(std::string const &filename,
 		glm::vec3 scale;
 	};
 	static_assert(sizeof(HierarchyEntry) == 4 + 4 + 4 + 4*3 + 4*4 + 4*3, "HierarchyEntry is packed.");
-	std::vector< HierarchyEntry > hierarchy;
-	read_chunk(file, "xfh0", &hierarchy);
+	std::vector< HierarchyEntry > unaligned_hierarchy; //(only used if the chunk's data isn't aligned)
+	std::span< HierarchyEntry const > hierarchy = file.view< HierarchyEntry >("xfh0", &unaligned_hierarchy);
 
 	struct MeshEntry {
 		uint32_t transform;
@@ -192,8 +1005,8 @@ void Scene::load(std::string const &filename,
 		uint32_t name_end;
 	};
 	static_assert(sizeof(MeshEntry) == 4 + 4 + 4, "MeshEntry is packed.");
-	std::vector< MeshEntry > meshes;
-	read_chunk(file, "msh0", &meshes);
+	std::vector< MeshEntry > unaligned_meshes; //(only used if the chunk's data isn't aligned)
+	std::span< MeshEntry const > meshes = file.view< MeshEntry >("msh0", &unaligned_meshes);
 
 	struct CameraEntry {
 		uint32_t transform;
@@ -202,8 +1015,8 @@ void Scene::load(std::string const &filename,
 		float clip_near, clip_far;
 	};
 	static_assert(sizeof(CameraEntry) == 4 + 4 + 4 + 4 + 4, "CameraEntry is packed.");
-	std::vector< CameraEntry > loaded_cameras;
-	read_chunk(file, "cam0", &loaded_cameras);
+	std::vector< CameraEntry > unaligned_loaded_cameras; //(only used if the chunk's data isn't aligned)
+	std::span< CameraEntry const > loaded_cameras = file.view< CameraEntry >("cam0", &unaligned_loaded_cameras);
 
 	struct LightEntry {
 		uint32_t transform;
@@ -214,8 +1027,8 @@ void Scene::load(std::string const &filename,
 		float fov;
 	};
 	static_assert(sizeof(LightEntry) == 4 + 1 + 3 + 4 + 4 + 4, "LightEntry is packed.");
-	std::vector< LightEntry > loaded_lights;
-	read_chunk(file, "lmp0", &loaded_lights);
+	std::vector< LightEntry > unaligned_loaded_lights; //(only used if the chunk's data isn't aligned)
+	std::span< LightEntry const > loaded_lights = file.view< LightEntry >("lmp0", &unaligned_loaded_lights);
 
 
 	//--------------------------------
@@ -255,7 +1068,7 @@ void Scene::load(std::string const &filename,
 		if (!(m.name_begin <= m.name_end && m.name_end <= names.size())) {
 			throw std::runtime_error("scene file '" + filename + "' contains mesh entry with invalid name indices");
 		}
-		std::string name = std::string(names.begin() + m.name_begin, names.begin() + m.name_end);
+		std::string_view name(names.data() + m.name_begin, m.name_end - m.name_begin);
 
 		if (on_drawable) {
 			on_drawable(*this, hierarchy_transforms[m.transform], name);
@@ -298,13 +1111,21 @@ void Scene::load(std::string const &filename,
 		Light *light = &lights.back();
 		light->type = static_cast<Light::Type>(l.type);
 		light->energy = glm::vec3(l.color) / 255.0f * l.energy;
+		light->distance = l.distance;
 		light->spot_fov = l.fov / 180.0f * 3.1415926f; //FOV is stored in degrees; convert to radians.
 	}
 
 	//load any extra that a subclass wants:
-	load_extra(file, names, hierarchy_transforms);
+	// (from the bytes after the standard chunks)
+	size_t extra_begin = 0;
+	for (char const *magic : {"str0", "xfh0", "msh0", "cam0", "lmp0"}) {
+		extra_begin = std::max(extra_begin, file.find(magic)->end);
+	}
+	MemoryStreamBuf extra_buf(file.file.data() + extra_begin, file.file.data() + file.file.size());
+	std::istream extra(&extra_buf);
+	load_extra(extra, std::vector< char >(names.begin(), names.end()), hierarchy_transforms);
 
-	if (file.peek() != EOF) {
+	if (extra.peek() != EOF) {
 		std::cerr << "WARNING: trailing data in scene file '" << filename << "'" << std::endl;
 	}
 
@@ -314,7 +1135,7 @@ void Scene::load(std::string const &filename,
 
 //-------------------------
 
-Scene::Scene(std::string const &filename, std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) {
+Scene::Scene(std::string const &filename, std::function< void(Scene &, Transform *, std::string_view) > const &on_drawable) {
 	load(filename, on_drawable);
 }
 
@@ -327,17 +1148,20 @@ Scene &Scene::operator=(Scene const &other) {
 	return *this;
 }
 
-void Scene::set(Scene const &other, std::unordered_map< Transform const *, Transform * > *transform_map_) {
-
-	std::unordered_map< Transform const *, Transform * > t2t_temp;
-	std::unordered_map< Transform const *, Transform * > &transform_to_transform = *(transform_map_ ? transform_map_ : &t2t_temp);
-
-	transform_to_transform.clear();
+void Scene::set(Scene const &other, std::unordered_map< Transform const *, Transform * > *transform_map) {
+	//pointer fixup works by position: each of other's transforms is numbered with its ordinal in other.transforms,
+	// which makes remapping a pointer two array lookups instead of a hash map insert + lookup:
 
-	//null transform maps to itself:
-	transform_to_transform.insert(std::make_pair(nullptr, nullptr));
+	std::vector< Transform const * > old_transforms;
+	old_transforms.reserve(other.transforms.size());
+	for (auto const &t : other.transforms) {
+		t.ordinal = uint32_t(old_transforms.size());
+		old_transforms.emplace_back(&t);
+	}
 
-	//Copy transforms and store mapping:
+	//Copy transforms (including their cached world matrices, so copies don't need to recompute them):
+	std::vector< Transform * > new_transforms;
+	new_transforms.reserve(old_transforms.size());
 	transforms.clear();
 	for (auto const &t : other.transforms) {
 		transforms.emplace_back();
@@ -346,32 +1170,53 @@ void Scene::set(Scene const &other, std::unordered_map< Transform const *, Trans
 		transforms.back().rotation = t.rotation;
 		transforms.back().scale = t.scale;
 		transforms.back().parent = t.parent; //will update later
-
-		//store mapping between transforms old and new:
-		auto ret = transform_to_transform.insert(std::make_pair(&t, &transforms.back()));
-		assert(ret.second);
+		transforms.back().cache = t.cache; //cache.parent will update later
+		new_transforms.emplace_back(&transforms.back());
 	}
 
+	auto remap = [&](Transform const *t) -> Transform * {
+		if (t == nullptr) return nullptr;
+		//check ordinal, since pointers to transforms outside of other.transforms won't have a meaningful one:
+		if (t->ordinal < old_transforms.size() && old_transforms[t->ordinal] == t) {
+			return new_transforms[t->ordinal];
+		}
+		throw std::runtime_error("Scene::set: copied scene refers to a transform it does not contain.");
+	};
+
 	//update transform parents:
 	for (auto &t : transforms) {
-		t.parent = transform_to_transform.at(t.parent);
+		//a cache computed for a different parent is stale, so just drop it:
+		if (t.cache.parent != t.parent) t.cache.valid = false;
+		t.parent = remap(t.parent);
+		t.cache.parent = t.parent;
 	}
 
 	//copy other's drawables, updating transform pointers:
 	drawables = other.drawables;
 	for (auto &d : drawables) {
-		d.transform = transform_to_transform.at(d.transform);
+		d.transform = remap(d.transform);
 	}
 
 	//copy other's cameras, updating transform pointers:
 	cameras = other.cameras;
 	for (auto &c : cameras) {
-		c.transform = transform_to_transform.at(c.transform);
+		c.transform = remap(c.transform);
 	}
 
 	//copy other's lights, updating transform pointers:
 	lights = other.lights;
 	for (auto &l : lights) {
-		l.transform = transform_to_transform.at(l.transform);
+		l.transform = remap(l.transform);
+	}
+
+	//only build the transform->transform map if asked for it:
+	if (transform_map) {
+		transform_map->clear();
+		transform_map->reserve(old_transforms.size() + 1);
+		//null transform maps to itself:
+		transform_map->emplace(nullptr, nullptr);
+		for (uint32_t i = 0; i < old_transforms.size(); ++i) {
+			transform_map->emplace(old_transforms[i], new_transforms[i]);
+		}
 	}
 }
@@ -15,10 +15,12 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include <limits>
 #include <list>
 #include <memory>
 #include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 
@@ -43,6 +45,39 @@ struct Scene {
 		glm::mat4x3 make_world_from_local() const;
 		glm::mat4x3 make_local_from_world() const;
 
+		//Computing world matrices walks the whole parent chain, so transforms also cache them:
+		// cached values are brought up to date by Scene::update_world_transforms() (which Scene::draw calls)
+		// or by update_world_cache() -- after that, these are O(1) lookups:
+		glm::mat4x3 const &world_from_local() const { return cache.world_from_local; }
+		glm::mat4x3 const &local_from_world() const { return cache.local_from_world; }
+
+		//bring the cached matrices up to date with the current position/rotation/scale (of this transform and its ancestors):
+		// (only recomputes matrices for transforms that changed or whose ancestors changed)
+		// 'pass' is used by Scene::update_world_transforms() to visit each transform once; leave it as zero otherwise
+		//  (or pass the number update_world_transforms() returned, which makes this O(1) for transforms it visited).
+		void update_world_cache(uint32_t pass = 0) const;
+
+		//-- internals --
+		struct Cache {
+			//local values the matrices were computed from (used to detect changes):
+			glm::vec3 position = glm::vec3(0.0f);
+			glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+			glm::vec3 scale = glm::vec3(1.0f);
+			Transform const *parent = nullptr;
+			uint32_t parent_version = 0; //parent's 'version' when the matrices were computed
+			uint32_t version = 0; //incremented whenever the matrices change, so descendants know to update
+			uint32_t pass = 0; //most recent update pass that visited this transform
+			bool valid = false;
+
+			glm::mat4x3 world_from_local = glm::mat4x3(1.0f);
+			glm::mat4x3 local_from_world = glm::mat4x3(1.0f);
+		};
+		mutable Cache cache;
+
+		//scratch index used by Scene::set() to remap pointers when copying:
+		// (n.b. this means a scene shouldn't be copied from by multiple threads at once)
+		mutable uint32_t ordinal = -1U;
+
 		//since hierarchy is tracked through pointers, copy-constructing a transform  is not advised:
 		Transform(Transform const &) = delete;
 		//if we delete some constructors, we need to let the compiler know that the default constructor is still okay:
@@ -54,6 +89,33 @@ struct Scene {
 		Drawable(Transform *transform_) : transform(transform_) { assert(transform); }
 		Transform * transform;
 
+		//Bounding box of the drawable's vertices, in transform-local space:
+		// used by Scene::draw to skip drawables outside the view frustum
+		// (the default, empty, box means "no bounds" -- the drawable is never culled)
+		glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
+		glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+		bool has_bounds() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+
+		//Bounding sphere of the drawable's vertices, in transform-local space (e.g., copied from Mesh::center and Mesh::radius):
+		// if set, Scene::draw culls against it as well as the box, and uses it to pick levels of detail
+		// (the default, negative, radius means "no sphere")
+		glm::vec3 center = glm::vec3(0.0f);
+		float radius = -1.0f;
+		bool has_sphere() const { return radius >= 0.0f; }
+
+		//Coarser levels of detail for the pipeline's mesh (e.g., copied from Mesh::lods), finest first:
+		// Scene::draw uses the coarsest level whose max_screen_size is at least the fraction of the screen height
+		// covered by the drawable's bounding sphere -- or, without one, the box's circumsphere (so drawables without bounds always use the pipeline's own mesh)
+		// levels are unindexed vertex ranges, drawn with the pipeline's vao and primitive type
+		struct LOD {
+			GLuint start = 0; //first vertex to draw
+			GLuint count = 0; //number of vertices to draw
+			float max_screen_size = 0.0f;
+		};
+		enum : uint32_t { MaxLODs = 4 };
+		LOD lods[MaxLODs];
+		uint32_t lod_count = 0;
+
 		//Contains all the data needed to run the OpenGL pipeline:
 		struct Pipeline {
 			GLuint program = 0; //shader program; passed to glUseProgram
@@ -65,12 +127,81 @@ struct Scene {
 			GLuint start = 0; //first vertex to draw; passed to glDrawArrays
 			GLuint count = 0; //number of vertices to draw; passed to glDrawArrays
 
+			//indexed meshes (index_count != 0) are drawn with glDrawElementsBaseVertex instead:
+			// indices come from the element array buffer attached to 'vao' and are relative to 'start'
+			GLenum index_type = GL_UNSIGNED_SHORT; //type of indices; passed to glDrawElementsBaseVertex
+			GLuint index_start = 0; //first index to draw (counted in indices, not bytes)
+			GLuint index_count = 0; //number of indices to draw; zero means "use glDrawArrays"
+
+			//quantized meshes (see MeshBuffer::Quantized) store positions relative to their bounds;
+			// Scene::draw passes the mesh's dequantization parameters (Mesh::position_offset and position_scale) in these uniforms:
+			glm::vec3 position_offset = glm::vec3(0.0f);
+			glm::vec3 position_scale = glm::vec3(1.0f);
+			GLuint POSITION_OFFSET_vec3 = -1U; //uniform location for position_offset
+			GLuint POSITION_SCALE_vec3 = -1U; //uniform location for position_scale
+
 			//uniforms:
 			GLuint CLIP_FROM_OBJECT_mat4 = -1U; //uniform location for object to clip space matrix
 			GLuint LIGHT_FROM_OBJECT_mat4x3 = -1U; //uniform location for object to light space (== world space) matrix
 			GLuint LIGHT_FROM_NORMAL_mat3 = -1U; //uniform location for normal to light space (== world space) matrix
 
-			std::function< void() > set_uniforms; //(optional) function to set any other useful uniforms
+			//alternatively, the three matrices above can come from a uniform block (declared as below, attached to binding ObjectMatricesBinding):
+			//  layout(std140) uniform ObjectMatrices { mat4 CLIP_FROM_OBJECT; mat4x3 LIGHT_FROM_OBJECT; mat3 LIGHT_FROM_NORMAL; };
+			// Scene::draw writes every such drawable's matrices into one buffer per frame, and selects each drawable's slot with glBindBufferRange.
+			GLuint OBJECT_MATRICES_block = -1U; //uniform block index; if set, the uniform locations above are ignored
+
+			//lighting: Scene::draw uploads the scene's lights to a uniform block (attached to binding LightsBinding) once per draw() call,
+			// then picks the (up to) MaxObjectLights lights that reach each drawable and passes their indices in these uniforms:
+			GLuint OBJECT_LIGHT_COUNT_int = -1U; //uniform location for number of lights affecting the object
+			GLuint OBJECT_LIGHTS_int_array = -1U; //uniform location for int[MaxObjectLights] array of indices into the Lights block
+			//alternatively, the program can use clustered lighting, which handles many more lights (see LightClusters.hpp):
+			// Scene::draw then attaches cluster parameters to binding ClustersBinding and binds texture buffers with
+			// light data, cells, and light lists to texture units ClusterTextureUnit + 0, 1, 2
+			bool clustered_lights = false;
+
+			//other per-drawable uniforms (e.g., material parameters):
+			// these are stored in place, so copying a drawable doesn't allocate, and Scene::draw skips re-uploading values
+			// that haven't changed since the last drawable with the same program
+			struct Uniform {
+				GLuint location = -1U; //uniform location in 'program'
+				GLenum type = 0; //GL_FLOAT, GL_FLOAT_VEC[234], GL_INT, or GL_INT_VEC[234]; 0 means "slot unused"
+				union {
+					float f[4];
+					GLint i[4];
+				} value = { };
+			};
+			enum : uint32_t { UniformCount = 4 };
+			Uniform uniforms[UniformCount];
+
+			//set a uniform value (replacing any existing value for the same location):
+			// note: will throw if all UniformCount slots are in use
+			void set_uniform(GLuint location, float value);
+			void set_uniform(GLuint location, glm::vec2 const &value);
+			void set_uniform(GLuint location, glm::vec3 const &value);
+			void set_uniform(GLuint location, glm::vec4 const &value);
+			void set_uniform(GLuint location, GLint value);
+			void set_uniform(GLuint location, glm::ivec2 const &value);
+			void set_uniform(GLuint location, glm::ivec3 const &value);
+			void set_uniform(GLuint location, glm::ivec4 const &value);
+
+			//(optional) function to set any other useful uniforms:
+			// prefer 'uniforms' above where possible -- this is called for every draw and prevents instancing
+			std::function< void() > set_uniforms;
+
+			//(optional) instanced variant of this pipeline:
+			// Scene::draw uses it to draw groups of drawables that share program, vao, primitives, and textures (and have no uniforms or set_uniforms)
+			// with a single draw call. World matrices are streamed through a per-instance attribute.
+			struct Instanced {
+				GLuint program = 0; //instanced version of 'program'
+				GLuint vao = 0; //same attributes as 'vao', but for 'program' above -- see MeshBuffer::make_instanced_vao_for_program()
+				GLuint WORLD_FROM_OBJECT_mat4x3 = -1U; //per-instance attribute location (occupies four consecutive locations)
+				GLuint CLIP_FROM_WORLD_mat4 = -1U; //uniform location for world to clip space matrix
+				GLuint LIGHT_FROM_WORLD_mat4x3 = -1U; //uniform location for world to light space matrix
+				GLuint OBJECT_LIGHT_COUNT_int = -1U; //as above (lights are picked for the whole group)
+				GLuint OBJECT_LIGHTS_int_array = -1U; //as above
+				GLuint POSITION_OFFSET_vec3 = -1U; //as above (a group always shares one mesh)
+				GLuint POSITION_SCALE_vec3 = -1U; //as above
+			} instanced;
 
 			//texture objects to bind for the first TextureCount textures:
 			enum : uint32_t { TextureCount = 4 };
@@ -112,27 +243,65 @@ struct Scene {
 		//  (i.e., "red, gree, blue" light color)
 		glm::vec3 energy = glm::vec3(1.0f);
 
+		//Point and spot light specific:
+		float distance = 0.0f; //distance at which the light fades out completely (0 means no limit)
+
 		//Spotlight specific:
 		float spot_fov = glm::radians(45.0f); //spot cone fov (in radians)
 	};
 
+	//uniform buffer binding point used for Drawable::Pipeline::OBJECT_MATRICES_block:
+	static constexpr GLuint ObjectMatricesBinding = 0;
+
+	//uniform buffer binding point for the Lights block, which holds (up to) MaxLights lights:
+	// (in the std140 layout of 'struct { vec4 position; vec4 direction; vec4 energy; } LIGHTS[MaxLights]' -- see LitColorTextureProgram for details)
+	// if the scene has no lights, a default hemisphere light is used
+	static constexpr GLuint LightsBinding = 1;
+	static constexpr uint32_t MaxLights = 128;
+	//maximum number of lights that can affect a single drawable:
+	static constexpr uint32_t MaxObjectLights = 8;
+	// (the above limits do not apply to clustered lighting)
+
+	//uniform buffer binding point and first texture unit used for clustered lighting:
+	static constexpr GLuint ClustersBinding = 2;
+	static constexpr GLuint ClusterTextureUnit = Drawable::Pipeline::TextureCount;
+
 	//Scenes, of course, may have many of the above objects:
 	std::list< Transform > transforms;
 	std::list< Drawable > drawables;
 	std::list< Camera > cameras;
 	std::list< Light > lights;
 
+	//Update the cached world matrices of all transforms in a single pass:
+	// (called by draw(); call it yourself if you want to use Transform::world_from_local() before drawing)
+	// returns the pass number it used; passing that to Transform::update_world_cache() skips transforms this call already visited
+	uint32_t update_world_transforms() const;
+
+	//Counts of what happened during a draw() call (pass a pointer to one to draw() to get them):
+	struct DrawStats {
+		uint32_t drawn = 0; //drawables submitted to OpenGL
+		uint32_t culled = 0; //drawables skipped because their bounds were outside the view frustum
+		uint32_t state_changes = 0; //program, vertex array, and texture binds issued
+		uint32_t draw_calls = 0; //glDraw* calls issued (instanced draws count once)
+		uint64_t triangles = 0; //triangles submitted (at the selected levels of detail)
+		uint64_t full_detail_triangles = 0; //triangles that would have been submitted without levels of detail
+	};
+
 	//The "draw" function provides a convenient way to pass all the things in a scene to OpenGL:
-	void draw(Camera const &camera) const;
+	// 'viewport' is the current glViewport (x, y, width, height) -- clustered lighting uses it to find each fragment's cell
+	void draw(Camera const &camera, glm::ivec4 const &viewport, DrawStats *stats = nullptr) const;
 
 	//..sometimes, you want to draw with a custom projection matrix and/or light space:
-	void draw(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from_world = glm::mat4x3(1.0f)) const;
+	// (drawables with bounds are culled against the frustum of clip_from_world)
+	// (drawables are drawn sorted by program, vertex array, textures, and then front-to-back -- not in list order)
+	void draw(glm::mat4 const &clip_from_world, glm::ivec4 const &viewport, glm::mat4x3 const &light_from_world = glm::mat4x3(1.0f), DrawStats *stats = nullptr) const;
 
 	//add transforms/objects/cameras from a scene file to this scene:
 	// the 'on_drawable' callback gives your code a chance to look up mesh data and make Drawables:
+	// (the mesh name it is passed is only valid during the callback)
 	// throws on file format errors
 	void load(std::string const &filename,
-		std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable = nullptr
+		std::function< void(Scene &, Transform *, std::string_view) > const &on_drawable = nullptr
 	);
 
 	//this function is called to read extra chunks from the scene file after the main chunks are read:
@@ -143,11 +312,12 @@ struct Scene {
 	Scene() = default;
 
 	//load a scene:
-	Scene(std::string const &filename, std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable);
+	Scene(std::string const &filename, std::function< void(Scene &, Transform *, std::string_view) > const &on_drawable);
 
 	//copy a scene (with proper pointer fixup):
 	Scene(Scene const &); //...as a constructor
 	Scene &operator=(Scene const &); //...as scene = scene
 	//... as a set() function that optionally returns the transform->transform mapping:
+	// (throws if other's drawables, cameras, or lights refer to transforms outside of other)
 	void set(Scene const &, std::unordered_map< Transform const *, Transform * > *transform_map = nullptr);
 };
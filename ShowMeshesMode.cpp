@@ -28,13 +28,11 @@ ShowMeshesMode::ShowMeshesMode(MeshBuffer const &buffer_) : buffer(buffer_) {
 		scene_drawable->pipeline.type = GL_TRIANGLES;
 		scene_drawable->pipeline.start = 0;
 		scene_drawable->pipeline.count = 0;
+		scene_drawable->pipeline.index_count = 0;
 	}
 
-	//select first mesh in buffer:
-	if (!buffer.meshes.empty()) {
-		current_mesh_name = buffer.meshes.begin()->first;
-	}
-	select_prev_mesh();
+	//select first mesh in buffer (meshes are shown in file order):
+	select_mesh(buffer.size() > 0 ? MeshBuffer::MeshId{0} : MeshBuffer::MeshId{});
 }
 
 ShowMeshesMode::~ShowMeshesMode() {
@@ -123,7 +121,7 @@ void ShowMeshesMode::draw(glm::uvec2 const &drawable_size) {
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LEQUAL);
 
-	scene.draw(*scene_camera);
+	scene.draw(*scene_camera, glm::ivec4(0, 0, drawable_size.x, drawable_size.y));
 
 	{ //decorate with some lines:
 		DrawLines draw_lines(scene_camera->make_projection() * glm::mat4(scene_camera->transform->make_local_from_world()));
@@ -154,57 +152,38 @@ void ShowMeshesMode::draw(glm::uvec2 const &drawable_size) {
 	}
 }
 
-void ShowMeshesMode::select_prev_mesh() {
-	auto f = buffer.meshes.find(current_mesh_name);
-	if (f != buffer.meshes.end()) {
-		if (f != buffer.meshes.begin()) --f;
-	}
-
-	if (f != buffer.meshes.end()) {
-		current_mesh_name = f->first;
-		scene_drawable->pipeline.type = f->second.type;
-		scene_drawable->pipeline.start = f->second.start;
-		scene_drawable->pipeline.count = f->second.count;
-		current_mesh_min = f->second.min;
-		current_mesh_max = f->second.max;
+void ShowMeshesMode::select_mesh(MeshBuffer::MeshId id) {
+	current_mesh = id;
+	if (current_mesh) {
+		Mesh const &mesh = buffer.lookup(current_mesh);
+		current_mesh_name = buffer.name(current_mesh);
+		scene_drawable->pipeline.type = mesh.type;
+		scene_drawable->pipeline.start = mesh.start;
+		scene_drawable->pipeline.count = mesh.count;
+		scene_drawable->pipeline.index_type = mesh.index_type;
+		scene_drawable->pipeline.index_start = mesh.index_start;
+		scene_drawable->pipeline.index_count = mesh.index_count;
+		current_mesh_min = mesh.min;
+		current_mesh_max = mesh.max;
 	} else {
 		current_mesh_name = "";
 		scene_drawable->pipeline.type = GL_TRIANGLES;
 		scene_drawable->pipeline.start = 0;
 		scene_drawable->pipeline.count = 0;
+		scene_drawable->pipeline.index_count = 0;
 		current_mesh_min = glm::vec3(0.0f);
 		current_mesh_max = glm::vec3(0.0f);
 	}
 }
 
-void ShowMeshesMode::select_next_mesh() {
-	auto f = buffer.meshes.find(current_mesh_name);
-	if (f != buffer.meshes.end()) {
-		++f;
-		if (f == buffer.meshes.end()) --f;
-	}
-	if (f == buffer.meshes.end()) {
-		auto temp = buffer.meshes.rbegin();
-		if (temp != buffer.meshes.rend()) {
-			++temp;
-			f = temp.base();
-			assert(f != buffer.meshes.end());
-		}
+void ShowMeshesMode::select_prev_mesh() {
+	if (current_mesh && current_mesh.index > 0) {
+		select_mesh(MeshBuffer::MeshId{current_mesh.index - 1});
 	}
+}
 
-	if (f != buffer.meshes.end()) {
-		current_mesh_name = f->first;
-		scene_drawable->pipeline.type = f->second.type;
-		scene_drawable->pipeline.start = f->second.start;
-		scene_drawable->pipeline.count = f->second.count;
-		current_mesh_min = f->second.min;
-		current_mesh_max = f->second.max;
-	} else {
-		current_mesh_name = "";
-		scene_drawable->pipeline.type = GL_TRIANGLES;
-		scene_drawable->pipeline.start = 0;
-		scene_drawable->pipeline.count = 0;
-		current_mesh_min = glm::vec3(0.0f);
-		current_mesh_max = glm::vec3(0.0f);
+void ShowMeshesMode::select_next_mesh() {
+	if (current_mesh && current_mesh.index + 1 < buffer.size()) {
+		select_mesh(MeshBuffer::MeshId{current_mesh.index + 1});
 	}
 }
@@ -91,12 +91,14 @@ void ShowSceneMode::draw(glm::uvec2 const &drawable_size) {
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LEQUAL);
 
-	scene.draw(*scene_camera);
+	Scene::DrawStats stats;
+	scene.draw(*scene_camera, glm::ivec4(0, 0, drawable_size.x, drawable_size.y), &stats);
 
 	{ //decorate with some lines:
-		DrawLines draw_lines(scene_camera->make_projection() * glm::mat4(scene_camera->transform->make_local_from_world()));
+		//(scene.draw() above brought cached world matrices up to date)
+		DrawLines draw_lines(scene_camera->make_projection() * glm::mat4(scene_camera->transform->local_from_world()));
 		for (auto &transform : scene.transforms) {
-			glm::mat4 world_from_local = transform.make_world_from_local();
+			glm::mat4 world_from_local = transform.world_from_local();
 			auto xf = [&world_from_local](glm::vec3 const &vec) {
 				return glm::vec3(world_from_local * glm::vec4(vec, 1.0f));
 			};
@@ -106,7 +108,7 @@ void ShowSceneMode::draw(glm::uvec2 const &drawable_size) {
 
 			if (transform.parent) {
 				//connect to parent:
-				glm::vec3 p = glm::vec3(transform.parent->make_world_from_local()[3]);
+				glm::vec3 p = transform.parent->world_from_local()[3];
 				draw_lines.draw(p, xf(glm::vec3(0.0f)), glm::u8vec4(0xff, 0xff, 0x00, 0xff));
 			}
 
@@ -136,4 +138,24 @@ void ShowSceneMode::draw(glm::uvec2 const &drawable_size) {
 		*/
 	}
 
+	{ //draw stats in the corner of the screen:
+		glDisable(GL_DEPTH_TEST);
+		float aspect = float(drawable_size.x) / float(drawable_size.y);
+		DrawLines lines(glm::mat4(
+			1.0f / aspect, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f
+		));
+		constexpr float H = 0.05f;
+		lines.draw_text("drawn " + std::to_string(stats.drawn) + ", culled " + std::to_string(stats.culled) + ", state changes " + std::to_string(stats.state_changes) + ", draw calls " + std::to_string(stats.draw_calls),
+			glm::vec3(-aspect + 0.5f * H, 1.0f - 1.5f * H, 0.0f),
+			glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+			glm::u8vec4(0xff, 0xff, 0xff, 0xff));
+		lines.draw_text("triangles " + std::to_string(stats.triangles) + " (" + std::to_string(stats.full_detail_triangles) + " at full detail)",
+			glm::vec3(-aspect + 0.5f * H, 1.0f - 3.0f * H, 0.0f),
+			glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+			glm::u8vec4(0xff, 0xff, 0xff, 0xff));
+	}
+
 }
@@ -1,14 +1,19 @@
 #include "Sound.hpp"
 #include "load_wav.hpp"
 #include "load_opus.hpp"
+#include "sample_cache.hpp"
 
 #include <SDL3/SDL.h>
 
 #include <list>
+#include <vector>
 #include <cassert>
 #include <exception>
 #include <iostream>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
 
 //local (to this file) data used by the audio system:
 namespace {
@@ -22,6 +27,55 @@ namespace {
 	//list of all currently playing samples:
 	std::list< std::shared_ptr< Sound::PlayingSample > > playing_samples;
 
+	//stereo sample (or stereo gain):
+	struct LR {
+		float l;
+		float r;
+	};
+	static_assert(sizeof(LR) == 8, "Sample is packed");
+
+	//per-callback bookkeeping for each playing sample:
+	struct Voice {
+		Sound::PlayingSample *playing_sample = nullptr;
+		LR start_pan, end_pan; //gains at the start and end of the block (including volume)
+		float start_rate = 1.0f, end_rate = 1.0f; //playback rate at the start and end of the block
+		float gain = 0.0f; //largest gain during the block (used to decide if the sample is audible)
+		bool was_virtual = false; //was the sample virtual in the previous block? (switching is faded over a block)
+	};
+
+	//per-callback bookkeeping, one per playing sample:
+	// (capacity is reserved by add_playing_sample on the game thread, so the audio callback never allocates here)
+	std::vector< Voice > voices;
+
+	//add to playing_samples (making sure 'voices' has room for it):
+	void add_playing_sample(std::shared_ptr< Sound::PlayingSample > const &playing_sample) {
+		Sound::lock();
+		playing_samples.emplace_back(playing_sample);
+		if (voices.capacity() < playing_samples.size()) {
+			voices.reserve(2 * playing_samples.size());
+		}
+		Sound::unlock();
+	}
+
+	//voice management (see Sound::set_max_voices and Sound::set_virtual_threshold):
+	uint32_t max_voices = 64;
+	float virtual_threshold = 1.0f / 1000.0f;
+
+	//metrics (written by the audio callback, read by Sound::get_metrics):
+	struct {
+		std::atomic< uint32_t > blocks{0};
+		std::atomic< uint32_t > late_blocks{0};
+		std::atomic< float > block_seconds{0.0f};
+		std::atomic< float > mix_seconds{0.0f};
+		std::atomic< uint32_t > voices_mixed{0};
+		std::atomic< uint32_t > voices_virtual{0};
+		std::atomic< float > peak{0.0f};
+		std::atomic< float > rms{0.0f};
+		std::array< std::atomic< float >, Sound::Metrics::HistorySize > load_history{};
+	} metrics;
+	static_assert(std::atomic< float >::is_always_lock_free, "metrics must not take locks in the audio callback");
+	static_assert(std::atomic< uint32_t >::is_always_lock_free, "metrics must not take locks in the audio callback");
+
 }
 
 //public-facing data:
@@ -38,6 +92,12 @@ void mix_audio(void *, SDL_AudioStream *stream, int additional_amount, int total
 //------------------------ public-facing --------------------------------
 
 Sound::Sample::Sample(std::string const &filename) {
+	//check for an already-decoded copy in the cache:
+	std::string cache_path = sample_cache_path(filename);
+	if (cache_path != "" && load_sample_cache(cache_path, &data)) {
+		return;
+	}
+
 	if (filename.size() >= 4 && filename.substr(filename.size()-4) == ".wav") {
 		load_wav(filename, &data);
 	} else if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".opus") {
@@ -45,6 +105,11 @@ Sound::Sample::Sample(std::string const &filename) {
 	} else {
 		throw std::runtime_error("Sample '" + filename + "' doesn't end in either \".wav\" or \".opus\" -- unsure how to load.");
 	}
+
+	//store decoded data so the next launch can skip decoding:
+	if (cache_path != "") {
+		save_sample_cache(cache_path, data);
+	}
 }
 
 Sound::Sample::Sample(std::vector< float > const &data_) : data(data_) {
@@ -92,25 +157,19 @@ void Sound::unlock() {
 
 std::shared_ptr< Sound::PlayingSample > Sound::play(Sample const &sample, float play_volume, float pan) {
 	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, play_volume, pan, false);
-	lock();
-	playing_samples.emplace_back(playing_sample);
-	unlock();
+	add_playing_sample(playing_sample);
 	return playing_sample;
 }
 
 std::shared_ptr< Sound::PlayingSample > Sound::play_3D(Sample const &sample, float play_volume, glm::vec3 const &position, float half_volume_radius) {
 	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, play_volume, position, half_volume_radius, false);
-	lock();
-	playing_samples.emplace_back(playing_sample);
-	unlock();
+	add_playing_sample(playing_sample);
 	return playing_sample;
 }
 
 std::shared_ptr< Sound::PlayingSample > Sound::loop(Sample const &sample, float play_volume, float pan) {
 	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, play_volume, pan, true);
-	lock();
-	playing_samples.emplace_back(playing_sample);
-	unlock();
+	add_playing_sample(playing_sample);
 	return playing_sample;
 }
 
@@ -118,9 +177,7 @@ std::shared_ptr< Sound::PlayingSample > Sound::loop(Sample const &sample, float
 
 std::shared_ptr< Sound::PlayingSample > Sound::loop_3D(Sample const &sample, float play_volume, glm::vec3 const &position, float half_volume_radius) {
 	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, play_volume, position, half_volume_radius, true);
-	lock();
-	playing_samples.emplace_back(playing_sample);
-	unlock();
+	add_playing_sample(playing_sample);
 	return playing_sample;
 }
 
@@ -133,12 +190,41 @@ void Sound::stop_all_samples() {
 	unlock();
 }
 
+void Sound::set_max_voices(uint32_t new_max_voices) {
+	lock();
+	max_voices = new_max_voices;
+	unlock();
+}
+
+void Sound::set_virtual_threshold(float new_threshold) {
+	lock();
+	virtual_threshold = new_threshold;
+	unlock();
+}
+
 void Sound::set_volume(float new_volume, float ramp) {
 	lock();
 	volume.set(new_volume, ramp);
 	unlock();
 }
 
+Sound::Metrics Sound::get_metrics() {
+	Metrics ret;
+	ret.blocks = metrics.blocks.load(std::memory_order_acquire);
+	ret.late_blocks = metrics.late_blocks.load(std::memory_order_relaxed);
+	ret.block_seconds = metrics.block_seconds.load(std::memory_order_relaxed);
+	ret.mix_seconds = metrics.mix_seconds.load(std::memory_order_relaxed);
+	ret.voices_mixed = metrics.voices_mixed.load(std::memory_order_relaxed);
+	ret.voices_virtual = metrics.voices_virtual.load(std::memory_order_relaxed);
+	ret.peak = metrics.peak.load(std::memory_order_relaxed);
+	ret.rms = metrics.rms.load(std::memory_order_relaxed);
+	//history is a ring buffer indexed by block count:
+	for (uint32_t i = 0; i < Metrics::HistorySize; ++i) {
+		ret.load_history[i] = metrics.load_history[(ret.blocks + i) % Metrics::HistorySize].load(std::memory_order_relaxed);
+	}
+	return ret;
+}
+
 //------------------
 
 void Sound::PlayingSample::set_volume(float new_volume, float ramp) {
@@ -170,6 +256,24 @@ void Sound::PlayingSample::set_half_volume_radius(float new_radius, float ramp)
 	Sound::unlock();
 }
 
+void Sound::PlayingSample::set_rate(float new_rate, float ramp) {
+	Sound::lock();
+	rate.set(std::max(0.0f, std::min(Resample::MaxRate, new_rate)), ramp);
+	Sound::unlock();
+}
+
+void Sound::PlayingSample::set_quality(Resample::Quality new_quality) {
+	Sound::lock();
+	quality = new_quality;
+	Sound::unlock();
+}
+
+void Sound::PlayingSample::set_priority(float new_priority) {
+	Sound::lock();
+	priority = new_priority;
+	Sound::unlock();
+}
+
 void Sound::PlayingSample::stop(float ramp) {
 	Sound::lock();
 	if (!(stopping || stopped)) {
@@ -305,11 +409,8 @@ void SDLCALL mix_audio(void *, SDL_AudioStream *stream_, int additional_amount,
 	if (total_amount <= 0) return;
 	assert(stream_ == stream && "callback should only be used with our main stream");
 
-	struct LR {
-		float l;
-		float r;
-	};
-	static_assert(sizeof(LR) == 8, "Sample is packed");
+	auto mix_start = std::chrono::steady_clock::now();
+
 
 	uint32_t samples = uint32_t(total_amount) / sizeof(LR);
 
@@ -319,6 +420,9 @@ void SDLCALL mix_audio(void *, SDL_AudioStream *stream_, int additional_amount,
 
 	LR *buffer = reinterpret_cast< LR * >(buffer_);
 
+	//scratch space for samples playing at rates other than 1.0:
+	float *resampled = SDL_stack_alloc(float, samples);
+
 	//zero the output buffer:
 	for (uint32_t s = 0; s < samples; ++s) {
 		buffer[s].l = 0.0f;
@@ -340,12 +444,19 @@ void SDLCALL mix_audio(void *, SDL_AudioStream *stream_, int additional_amount,
 	glm::vec3 end_position =  Sound::listener.position.value;
 	glm::vec3 end_right =  Sound::listener.right.value;
 
-	//add audio from each playing sample into the buffer:
-	for (auto si = playing_samples.begin(); si != playing_samples.end(); /* later */) {
-		Sound::PlayingSample &playing_sample = **si; //much more convenient than writing ** everywhere.
+	//(1) step every playing sample's parameters and figure out how loud it will be this block:
+	//n.b. 'voices' already has room for every playing sample (see add_playing_sample), so this doesn't allocate:
+	assert(voices.capacity() >= playing_samples.size());
+	voices.clear();
+	for (auto &ps : playing_samples) {
+		Sound::PlayingSample &playing_sample = *ps; //much more convenient than writing * everywhere.
+		voices.emplace_back();
+		Voice &voice = voices.back();
+		voice.playing_sample = &playing_sample;
+		voice.was_virtual = playing_sample.is_virtual;
 
 		//Figure out sample panning/volume at start...
-		LR start_pan;
+		LR &start_pan = voice.start_pan;
 		if (!(playing_sample.pan.value == playing_sample.pan.value)) {
 			//3D panning
 			compute_pan_from_listener_and_position(
@@ -368,7 +479,7 @@ void SDLCALL mix_audio(void *, SDL_AudioStream *stream_, int additional_amount,
 		step_value_ramp(elapsed, playing_sample.volume);
 
 		//..and end of the mix period:
-		LR end_pan;
+		LR &end_pan = voice.end_pan;
 		if (!(playing_sample.pan.value == playing_sample.pan.value)) {
 			//3D panning
 			compute_pan_from_listener_and_position(
@@ -384,34 +495,139 @@ void SDLCALL mix_audio(void *, SDL_AudioStream *stream_, int additional_amount,
 		end_pan.l *= end_volume * playing_sample.volume.value;
 		end_pan.r *= end_volume * playing_sample.volume.value;
 
-		//figure out a step to add at each sample so that pan will move smoothly from start to end:
-		LR pan = start_pan;
-		LR pan_step;
-		pan_step.l = (end_pan.l - start_pan.l) / samples;
-		pan_step.r = (end_pan.r - start_pan.r) / samples;
+		//..and the same for playback rate:
+		voice.start_rate = playing_sample.rate.value;
+		step_value_ramp(elapsed, playing_sample.rate);
+		voice.end_rate = playing_sample.rate.value;
 
-		assert(playing_sample.i < playing_sample.data.size());
+		voice.gain = std::max(std::max(start_pan.l, start_pan.r), std::max(end_pan.l, end_pan.r));
+	}
+
+	//(2) decide which samples are actually mixed:
+	// samples quieter than virtual_threshold are virtual; if more than max_voices remain, keep the highest-priority (then loudest) ones.
+	// (with hysteresis: voices that were virtual need twice the gain to become real, so voices near a limit don't flip every block)
+	uint32_t audible = 0;
+	for (auto &voice : voices) {
+		float threshold = (voice.was_virtual ? 2.0f * virtual_threshold : virtual_threshold);
+		voice.playing_sample->is_virtual = !(voice.gain >= threshold);
+		if (!voice.playing_sample->is_virtual) ++audible;
+	}
+	if (audible > max_voices) {
+		auto more_important = [](Voice const &a, Voice const &b) {
+			if (a.playing_sample->is_virtual != b.playing_sample->is_virtual) return !a.playing_sample->is_virtual;
+			if (a.playing_sample->priority != b.playing_sample->priority) return a.playing_sample->priority > b.playing_sample->priority;
+			float a_gain = (a.was_virtual ? a.gain : 2.0f * a.gain);
+			float b_gain = (b.was_virtual ? b.gain : 2.0f * b.gain);
+			return a_gain > b_gain;
+		};
+		std::nth_element(voices.begin(), voices.begin() + max_voices, voices.end(), more_important);
+		for (auto vi = voices.begin() + max_voices; vi != voices.end(); ++vi) {
+			vi->playing_sample->is_virtual = true;
+		}
+	}
+
+	//ramp voices that are switching between real and virtual from or to silence over this block, so they don't click:
+	for (auto &voice : voices) {
+		if (voice.was_virtual && !voice.playing_sample->is_virtual) {
+			voice.start_pan = LR{0.0f, 0.0f}; //fade in
+		} else if (!voice.was_virtual && voice.playing_sample->is_virtual) {
+			voice.end_pan = LR{0.0f, 0.0f}; //fade out (it is mixed for this one last block)
+		}
+	}
+
+	//(3) add audio from each real (or fading-out) sample into the buffer, and just advance virtual ones:
+	for (auto const &voice : voices) {
+		Sound::PlayingSample &playing_sample = *voice.playing_sample;
 
-		for (uint32_t i = 0; i < samples; ++i) {
-			//mix one sample based on current pan values:
-			buffer[i].l += pan.l * playing_sample.data[playing_sample.i];
-			buffer[i].r += pan.r * playing_sample.data[playing_sample.i];
+		assert(playing_sample.i < playing_sample.data.size());
 
-			//update position in sample:
-			playing_sample.i += 1;
-			if (playing_sample.i == playing_sample.data.size()) {
+		if (playing_sample.is_virtual && voice.was_virtual) {
+			//advance playback position by the same amount that mixing would have:
+			float advance = playing_sample.frac + 0.5f * (voice.start_rate + voice.end_rate) * samples;
+			uint64_t whole = uint64_t(advance);
+			playing_sample.frac = advance - float(whole);
+			uint64_t next = playing_sample.i + whole;
+			if (next >= playing_sample.data.size()) {
 				if (playing_sample.loop) {
-					playing_sample.i = 0;
+					next %= playing_sample.data.size();
 				} else {
-					break;
+					next = playing_sample.data.size();
 				}
 			}
+			playing_sample.i = uint32_t(next);
+			continue;
+		}
+
+		//figure out a step to add at each sample so that pan will move smoothly from start to end:
+		LR pan = voice.start_pan;
+		LR pan_step;
+		pan_step.l = (voice.end_pan.l - voice.start_pan.l) / samples;
+		pan_step.r = (voice.end_pan.r - voice.start_pan.r) / samples;
+
+		//back at normal rate after playing at some other rate, so round position to the nearest sample:
+		// (otherwise the leftover 'frac' would keep this voice off the direct-read path forever)
+		if (voice.start_rate == 1.0f && voice.end_rate == 1.0f && playing_sample.frac != 0.0f) {
+			if (playing_sample.frac >= 0.5f) {
+				playing_sample.i += 1;
+				if (playing_sample.i == playing_sample.data.size()) {
+					if (playing_sample.loop) {
+						playing_sample.i = 0;
+					} else {
+						playing_sample.frac = 0.0f;
+						continue; //(removed by step 4)
+					}
+				}
+			}
+			playing_sample.frac = 0.0f;
+		}
+
+		if (voice.start_rate == 1.0f && voice.end_rate == 1.0f) {
+			assert(playing_sample.frac == 0.0f);
+			//playing at normal rate, so can read data directly:
+			for (uint32_t i = 0; i < samples; ++i) {
+				//mix one sample based on current pan values:
+				buffer[i].l += pan.l * playing_sample.data[playing_sample.i];
+				buffer[i].r += pan.r * playing_sample.data[playing_sample.i];
+
+				//update position in sample:
+				playing_sample.i += 1;
+				if (playing_sample.i == playing_sample.data.size()) {
+					if (playing_sample.loop) {
+						playing_sample.i = 0;
+					} else {
+						break;
+					}
+				}
 
-			//update pan values:
-			pan.l += pan_step.l;
-			pan.r += pan_step.r;
+				//update pan values:
+				pan.l += pan_step.l;
+				pan.r += pan_step.r;
+			}
+		} else {
+			//playing at some other rate, so resample the whole block first:
+			uint32_t count = Resample::read(playing_sample.data, playing_sample.loop,
+				&playing_sample.i, &playing_sample.frac,
+				voice.start_rate, (voice.end_rate - voice.start_rate) / samples, playing_sample.quality,
+				resampled, samples);
+
+			for (uint32_t i = 0; i < count; ++i) {
+				buffer[i].l += pan.l * resampled[i];
+				buffer[i].r += pan.r * resampled[i];
+
+				pan.l += pan_step.l;
+				pan.r += pan_step.r;
+			}
 		}
+	}
 
+	uint32_t voices_mixed = 0;
+	for (auto const &voice : voices) {
+		if (!(voice.playing_sample->is_virtual && voice.was_virtual)) ++voices_mixed; //(includes voices fading out)
+	}
+
+	//(4) remove any samples that have finished:
+	for (auto si = playing_samples.begin(); si != playing_samples.end(); /* later */) {
+		Sound::PlayingSample &playing_sample = **si;
 		if (playing_sample.i >= playing_sample.data.size()
 		 || (playing_sample.stopping && playing_sample.volume.value == 0.0f)) { //sample has finished
 		 	playing_sample.stopped = true;
@@ -424,16 +640,32 @@ void SDLCALL mix_audio(void *, SDL_AudioStream *stream_, int additional_amount,
 		}
 	}
 
-	/*//DEBUG: report output power:
-	float max_power = 0.0f;
-	for (uint32_t s = 0; s < MIX_SAMPLES; ++s) {
-		max_power = std::max(max_power, (buffer[s].l * buffer[s].l + buffer[s].r * buffer[s].r));
+	//measure output level:
+	float peak = 0.0f;
+	float sum_squares = 0.0f;
+	for (uint32_t s = 0; s < samples; ++s) {
+		peak = std::max(peak, std::max(std::abs(buffer[s].l), std::abs(buffer[s].r)));
+		sum_squares += buffer[s].l * buffer[s].l + buffer[s].r * buffer[s].r;
 	}
-	std::cout << "Max Power: " << std::sqrt(max_power) << "; playing samples: " << playing_samples.size() << std::endl; //DEBUG
-	*/
 
 	SDL_PutAudioStreamData(stream, buffer_, len);
+	SDL_stack_free(resampled);
 	SDL_stack_free(buffer_);
+
+	//record metrics:
+	float mix_seconds = std::chrono::duration< float >(std::chrono::steady_clock::now() - mix_start).count();
+	uint32_t block = metrics.blocks.load(std::memory_order_relaxed);
+	metrics.block_seconds.store(elapsed, std::memory_order_relaxed);
+	metrics.mix_seconds.store(mix_seconds, std::memory_order_relaxed);
+	metrics.voices_mixed.store(voices_mixed, std::memory_order_relaxed);
+	metrics.voices_virtual.store(uint32_t(voices.size()) - voices_mixed, std::memory_order_relaxed);
+	metrics.peak.store(peak, std::memory_order_relaxed);
+	metrics.rms.store(std::sqrt(sum_squares / (2.0f * samples)), std::memory_order_relaxed);
+	metrics.load_history[block % Sound::Metrics::HistorySize].store(mix_seconds / elapsed, std::memory_order_relaxed);
+	if (mix_seconds > elapsed) {
+		metrics.late_blocks.fetch_add(1, std::memory_order_relaxed);
+	}
+	metrics.blocks.store(block + 1, std::memory_order_release);
 }
 
 
@@ -1,11 +1,14 @@
 #pragma once
 
+#include "resample.hpp"
+
 #include <glm/glm.hpp>
 
 #include <memory>
 #include <vector>
 #include <string>
 #include <cmath>
+#include <cstdint>
 
 //Game audio system. Simplified from f18-base3.
 //Uses 48kHz sampling rate.
@@ -16,6 +19,7 @@ namespace Sound {
 struct Sample {
 	//Load from a '.wav' or '.opus' file.
 	//  will warn and convert if sound is not already 48kHz mono:
+	//  (decoded data is cached on disk -- see sample_cache.hpp -- so later loads skip decoding)
 	Sample(std::string const &filename);
 	
 	//Directly supply an audio buffer:
@@ -59,6 +63,12 @@ struct PlayingSample {
 	void set_position(glm::vec3 const &new_position, float ramp = 1.0f / 60.0f);
 	//set the half-volume radius (use only on "3D" playing sounds):
 	void set_half_volume_radius(float new_radius, float ramp = 1.0f / 60.0f);
+	//set the playback rate (1.0 is normal; 2.0 is twice as fast and an octave higher; clamped to [0,4] -- see Resample::MaxRate):
+	void set_rate(float new_rate, float ramp = 1.0f / 60.0f);
+	//set the interpolation used when playing at rates other than 1.0 (see resample.hpp):
+	void set_quality(Resample::Quality new_quality);
+	//set the priority used to pick which samples are mixed when more than max_voices are audible (higher is more important):
+	void set_priority(float new_priority);
 
 	//'stop' will fade sample out over 'ramp' seconds and then remove it from the active samples:
 	void stop(float ramp = 1.0f / 60.0f);
@@ -68,12 +78,19 @@ struct PlayingSample {
 	// may result in bad results. Instead, use the functions above, which perform locking!
 	std::vector< float > const &data; //reference to sample data being played
 	uint32_t i = 0; //next data value to read
+	float frac = 0.0f; //fractional position past data[i] (only non-zero when playing at rate != 1.0)
 	bool loop = false; //should playback loop after data runs out?
 	bool stopping = false; //is playing stopping?
 	bool stopped = false; //was playback stopped (either by running out of sample, or by stop())?
+	bool is_virtual = false; //was sample skipped (too quiet, or over max_voices) in the most recent mix? (playback position still advances; see set_max_voices)
+	float priority = 0.0f;
 
 	Ramp< float > volume = Ramp< float >(1.0f);
 
+	//playback rate (pitch) control:
+	Ramp< float > rate = Ramp< float >(1.0f);
+	Resample::Quality quality = Resample::Cubic;
+
 	//2D playback panning control: ('NaN' if sound played in 3D mode)
 	Ramp< float > pan = Ramp< float >(std::numeric_limits< float >::quiet_NaN());
 
@@ -136,6 +153,33 @@ extern struct Listener listener;
 //"panic button" to shut off all currently playing sounds:
 void stop_all_samples();
 
+//voice management:
+// samples whose gain is below the "virtual threshold" -- or that are beyond the first max_voices (by priority, then gain) --
+// become "virtual": their playback position keeps advancing, but they aren't mixed. They are mixed again once they qualify.
+// (voices fade out over the block in which they become virtual and fade in over the block in which they become real;
+//  to keep voices near a limit from flipping every block, a virtual voice needs twice the threshold gain -- or twice the gain
+//  of a mixed voice of the same priority -- to be mixed again)
+void set_max_voices(uint32_t max_voices); //(default: 64)
+void set_virtual_threshold(float threshold); //(default: 1/1000, i.e., -60dB)
+
+//mixer metrics:
+// recorded by the audio callback into lock-free atomics; get_metrics() is safe to call from the game thread.
+// (fields are updated individually, so a snapshot may mix values from adjacent blocks)
+struct Metrics {
+	uint32_t blocks = 0; //total blocks mixed
+	uint32_t late_blocks = 0; //total blocks that took longer to mix than to play (i.e., missed their deadline)
+	float block_seconds = 0.0f; //playback duration of the most recent block
+	float mix_seconds = 0.0f; //time spent in the callback for the most recent block
+	uint32_t voices_mixed = 0; //samples mixed in the most recent block (including any fading out as they become virtual)
+	uint32_t voices_virtual = 0; //samples skipped (see set_max_voices) in the most recent block
+	float peak = 0.0f; //largest absolute output value in the most recent block
+	float rms = 0.0f; //root-mean-square output value in the most recent block
+	//mix_seconds / block_seconds for recent blocks, oldest first:
+	static constexpr uint32_t HistorySize = 64;
+	float load_history[HistorySize] = { };
+};
+Metrics get_metrics();
+
 //set global volume:
 void set_volume(float new_volume, float ramp = 1.0f / 60.0f);
 extern Ramp< float > volume;
@@ -0,0 +1,208 @@
+#include "TransformArray.hpp"
+
+#include "Scene.hpp"
+#include "ChunkFile.hpp"
+#include "Jobs.hpp"
+
+#include <algorithm>
+#include <span>
+#include <cassert>
+#include <stdexcept>
+#include <unordered_map>
+
+TransformArray::Handle TransformArray::add(Handle parent, std::string_view name,
+	glm::vec3 const &position, glm::quat const &rotation, glm::vec3 const &scale) {
+
+	if (parent && parent.index >= size()) {
+		throw std::runtime_error("TransformArray::add given a parent handle that isn't in the array.");
+	}
+
+	Handle ret;
+	ret.index = size();
+
+	parents.emplace_back(parent ? parent.index : NoParent);
+	positions.emplace_back(position);
+	rotations.emplace_back(rotation);
+	scales.emplace_back(scale);
+	world_from_locals.emplace_back(1.0f);
+	levels_dirty = true;
+
+	uint32_t begin = uint32_t(name_chars.size());
+	name_chars.insert(name_chars.end(), name.begin(), name.end());
+	name_ranges.emplace_back(begin, uint32_t(name_chars.size()));
+
+	return ret;
+}
+
+void TransformArray::clear() {
+	parents.clear();
+	positions.clear();
+	rotations.clear();
+	scales.clear();
+	world_from_locals.clear();
+	name_chars.clear();
+	name_ranges.clear();
+	level_order.clear();
+	level_starts.clear();
+	levels_dirty = true;
+}
+
+TransformArray::Handle TransformArray::find(std::string_view name_) const {
+	for (uint32_t i = 0; i < size(); ++i) {
+		if (name(Handle{i}) == name_) return Handle{i};
+	}
+	return Handle{};
+}
+
+std::string_view TransformArray::name(Handle handle) const {
+	assert(handle.index < size());
+	glm::uvec2 range = name_ranges[handle.index];
+	return std::string_view(name_chars.data() + range.x, range.y - range.x);
+}
+
+//compute world_from_local for transform i (all ancestors must already be computed):
+static inline void update_world_at(TransformArray &array, uint32_t i) {
+	//same math as Scene::Transform::make_parent_from_local():
+	glm::mat3 rot = glm::mat3_cast(array.rotations[i]);
+	glm::mat4x3 parent_from_local = glm::mat4x3(
+		rot[0] * array.scales[i].x,
+		rot[1] * array.scales[i].y,
+		rot[2] * array.scales[i].z,
+		array.positions[i]
+	);
+
+	uint32_t parent = array.parents[i];
+	if (parent == TransformArray::NoParent) {
+		array.world_from_locals[i] = parent_from_local;
+	} else {
+		assert(parent < i && "transforms are in topological order");
+		array.world_from_locals[i] = array.world_from_locals[parent] * glm::mat4(parent_from_local);
+	}
+}
+
+void TransformArray::update_world(uint32_t threads) {
+	uint32_t count = size();
+
+	//small arrays aren't worth the synchronization:
+	constexpr uint32_t Grain = 4096;
+	if (threads <= 1 || count <= Grain) {
+		for (uint32_t i = 0; i < count; ++i) {
+			update_world_at(*this, i);
+		}
+		return;
+	}
+
+	if (levels_dirty) update_levels();
+
+	//every transform in a level depends only on transforms in earlier levels, so each level can be split freely:
+	for (uint32_t l = 0; l + 1 < level_starts.size(); ++l) {
+		uint32_t const *order = level_order.data() + level_starts[l];
+		Jobs::parallel_for(level_starts[l+1] - level_starts[l], Grain, [&](uint32_t begin, uint32_t end){
+			for (uint32_t i = begin; i < end; ++i) {
+				update_world_at(*this, order[i]);
+			}
+		}, threads);
+	}
+}
+
+void TransformArray::update_levels() {
+	uint32_t count = size();
+
+	//depth of each transform (parents come first, so one pass suffices):
+	std::vector< uint32_t > depths(count);
+	uint32_t levels = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		depths[i] = (parents[i] == NoParent ? 0 : depths[parents[i]] + 1);
+		levels = std::max(levels, depths[i] + 1);
+	}
+
+	//counting sort by depth (keeps indices increasing within a level, for better memory access):
+	level_starts.assign(levels + 1, 0);
+	for (uint32_t d : depths) {
+		level_starts[d + 1] += 1;
+	}
+	for (uint32_t l = 0; l < levels; ++l) {
+		level_starts[l + 1] += level_starts[l];
+	}
+	level_order.resize(count);
+	std::vector< uint32_t > fill(level_starts.begin(), level_starts.end() - 1);
+	for (uint32_t i = 0; i < count; ++i) {
+		level_order[fill[depths[i]]++] = i;
+	}
+
+	levels_dirty = false;
+}
+
+void TransformArray::set(Scene const &scene, std::vector< Handle > *handles) {
+	clear();
+
+	//Scene's list isn't necessarily in topological order, so add transforms parents-first:
+	std::unordered_map< Scene::Transform const *, Handle > added;
+	added.reserve(scene.transforms.size());
+
+	std::vector< Scene::Transform const * > stack;
+	for (auto const &transform : scene.transforms) {
+		//walk up to the first not-yet-added ancestor, then add back down:
+		for (Scene::Transform const *t = &transform; t && !added.count(t); t = t->parent) {
+			if (stack.size() > scene.transforms.size()) {
+				throw std::runtime_error("Scene transform hierarchy contains a cycle.");
+			}
+			stack.emplace_back(t);
+		}
+		while (!stack.empty()) {
+			Scene::Transform const *t = stack.back();
+			stack.pop_back();
+			Handle parent = (t->parent ? added.at(t->parent) : Handle{});
+			added.emplace(t, add(parent, t->name, t->position, t->rotation, t->scale));
+		}
+	}
+
+	if (handles) {
+		handles->clear();
+		handles->reserve(scene.transforms.size());
+		for (auto const &transform : scene.transforms) {
+			handles->emplace_back(added.at(&transform));
+		}
+	}
+}
+
+void TransformArray::load(std::string const &filename) {
+	clear();
+
+	ChunkFile file(filename);
+
+	std::span< char const > names = file.view< char >("str0");
+
+	//n.b. same layout as in Scene::load:
+	struct HierarchyEntry {
+		uint32_t parent;
+		uint32_t name_begin;
+		uint32_t name_end;
+		glm::vec3 position;
+		glm::quat rotation;
+		glm::vec3 scale;
+	};
+	static_assert(sizeof(HierarchyEntry) == 4 + 4 + 4 + 4*3 + 4*4 + 4*3, "HierarchyEntry is packed.");
+	std::vector< HierarchyEntry > unaligned_hierarchy; //(only used if the chunk's data isn't aligned)
+	std::span< HierarchyEntry const > hierarchy = file.view< HierarchyEntry >("xfh0", &unaligned_hierarchy);
+
+	parents.reserve(hierarchy.size());
+	positions.reserve(hierarchy.size());
+	rotations.reserve(hierarchy.size());
+	scales.reserve(hierarchy.size());
+	world_from_locals.reserve(hierarchy.size());
+	name_ranges.reserve(hierarchy.size());
+	name_chars.reserve(names.size());
+
+	for (auto const &h : hierarchy) {
+		if (h.parent != -1U && h.parent >= size()) {
+			throw std::runtime_error("scene file '" + filename + "' did not contain transforms in topological-sort order.");
+		}
+		if (!(h.name_begin <= h.name_end && h.name_end <= names.size())) {
+			throw std::runtime_error("scene file '" + filename + "' contains hierarchy entry with invalid name indices");
+		}
+		add(h.parent == -1U ? Handle{} : Handle{h.parent},
+			std::string_view(names.data() + h.name_begin, h.name_end - h.name_begin),
+			h.position, h.rotation, h.scale);
+	}
+}
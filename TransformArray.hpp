@@ -0,0 +1,78 @@
+#pragma once
+
+/*
+ * A TransformArray is a flat, data-oriented alternative to Scene's std::list< Transform >:
+ *  - transform data is stored in parallel arrays (parent index, position, rotation, scale, world matrix)
+ *  - transforms are kept in topological order (parents before children), as .scene files already guarantee
+ *  - transforms are referred to by Handles, which remain valid as more transforms are added
+ *
+ * Because of this, updating world matrices is a single linear pass over the arrays,
+ * and copying a TransformArray is a handful of memcpy's.
+ *
+ */
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct Scene;
+
+struct TransformArray {
+	//Handles are indices into the arrays (transforms are only ever appended, so they never move):
+	struct Handle {
+		uint32_t index = -1U;
+		explicit operator bool() const { return index != -1U; }
+		bool operator==(Handle const &) const = default;
+	};
+
+	//add a transform as a child of 'parent' (or as a root, if parent is a default Handle):
+	// note: will throw if parent is not a handle of this array.
+	Handle add(Handle parent, std::string_view name,
+		glm::vec3 const &position = glm::vec3(0.0f),
+		glm::quat const &rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+		glm::vec3 const &scale = glm::vec3(1.0f));
+
+	uint32_t size() const { return uint32_t(parents.size()); }
+	void clear();
+
+	//find a transform by name (returns a default Handle if not found):
+	Handle find(std::string_view name) const;
+	std::string_view name(Handle handle) const;
+
+	//compute world_from_local for every transform in one front-to-back pass:
+	// if threads > 1, transforms are instead updated one hierarchy level at a time, with each level split across threads (see Jobs.hpp)
+	// either way, results are identical
+	void update_world(uint32_t threads = 1);
+
+	//make the contents of this array match a scene's transforms:
+	// (handles are written in the order of scene.transforms; throws if the hierarchy has a cycle)
+	void set(Scene const &scene, std::vector< Handle > *handles = nullptr);
+
+	//load the transforms from a scene file (without any drawables, cameras, or lights):
+	// note: will throw on file format errors.
+	void load(std::string const &filename);
+
+	//-- data --
+	//(these are public for fast iteration; use add() to keep them consistent and in topological order)
+	// note: if you edit 'parents' directly, also set levels_dirty
+	static constexpr uint32_t NoParent = -1U;
+	std::vector< uint32_t > parents; //index of parent transform (always less than own index), or NoParent
+	std::vector< glm::vec3 > positions;
+	std::vector< glm::quat > rotations;
+	std::vector< glm::vec3 > scales;
+	std::vector< glm::mat4x3 > world_from_locals; //computed by update_world()
+
+	//names are stored as ranges in a single character array (so copies don't allocate per-transform):
+	std::vector< char > name_chars;
+	std::vector< glm::uvec2 > name_ranges; //[begin,end) in name_chars
+
+	//transform indices grouped by depth in the hierarchy (used by threaded update_world; rebuilt when levels_dirty is set):
+	std::vector< uint32_t > level_order;
+	std::vector< uint32_t > level_starts; //level i is level_order[level_starts[i], level_starts[i+1])
+	bool levels_dirty = true; //set by add() and clear() (and so by set() and load())
+	void update_levels();
+};
@@ -0,0 +1,206 @@
+#include "Scene.hpp"
+#include "TransformArray.hpp"
+#include "Jobs.hpp"
+#include "LightClusters.hpp"
+#include "resample.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <iostream>
+#include <random>
+#include <string>
+
+//Micro-benchmarks for scene copying, transform updates, light clustering, and audio resampling.
+// run as: ./bench-scene [transform count] [parallel transform count] [light count]
+
+//build a synthetic scene with a random (but topologically sorted) hierarchy and a drawable per transform:
+static void make_scene(Scene *scene, uint32_t count) {
+	std::mt19937 mt(0x15466);
+	std::vector< Scene::Transform * > transforms;
+	transforms.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		scene->transforms.emplace_back();
+		Scene::Transform *t = &scene->transforms.back();
+		t->name = "transform-" + std::to_string(i);
+		t->position = glm::vec3(float(mt() % 100), float(mt() % 100), float(mt() % 100)) * 0.1f;
+		t->rotation = glm::normalize(glm::quat(1.0f, 0.01f * float(mt() % 10), 0.0f, 0.0f));
+		//about one in sixteen transforms is a root; the rest have some earlier transform as a parent:
+		if (i > 0 && mt() % 16 != 0) t->parent = transforms[mt() % i];
+		transforms.emplace_back(t);
+
+		scene->drawables.emplace_back(t);
+		if (i % 1000 == 0) scene->lights.emplace_back(t);
+	}
+	scene->cameras.emplace_back(transforms[0]);
+}
+
+//run 'fn' 'iterations' times and report average time per run:
+template< typename F >
+static void bench(std::string const &name, uint32_t iterations, F const &fn) {
+	fn(); //warm up
+	auto before = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < iterations; ++i) {
+		fn();
+	}
+	auto after = std::chrono::high_resolution_clock::now();
+	double ms = std::chrono::duration< double >(after - before).count() * 1000.0 / iterations;
+	std::cout << "  " << name << ": " << ms << " ms" << std::endl;
+}
+
+//thread counts to try: powers of two, plus all available threads:
+static std::vector< uint32_t > thread_counts() {
+	std::vector< uint32_t > counts;
+	for (uint32_t threads = 1; threads < Jobs::thread_count(); threads *= 2) {
+		counts.emplace_back(threads);
+	}
+	counts.emplace_back(Jobs::thread_count());
+	return counts;
+}
+
+int main(int argc, char **argv) {
+	uint32_t count = 50000;
+	if (argc > 1) count = uint32_t(std::stoul(argv[1]));
+
+	Scene scene;
+	make_scene(&scene, count);
+	std::cout << "Scene with " << scene.transforms.size() << " transforms, " << scene.drawables.size() << " drawables:" << std::endl;
+
+	{ //copying:
+		Scene copy;
+		bench("Scene::set", 20, [&](){
+			copy.set(scene);
+		});
+
+		std::unordered_map< Scene::Transform const *, Scene::Transform * > transform_map;
+		bench("Scene::set (with transform_map)", 20, [&](){
+			copy.set(scene, &transform_map);
+		});
+
+		TransformArray array;
+		array.set(scene);
+		TransformArray array_copy;
+		bench("TransformArray copy", 20, [&](){
+			array_copy = array;
+		});
+	}
+
+	{ //world transform updates:
+		bench("Scene::update_world_transforms (clean)", 20, [&](){
+			scene.update_world_transforms();
+		});
+
+		bench("Scene::update_world_transforms (all dirty)", 20, [&](){
+			for (auto &t : scene.transforms) t.position.x += 1.0f;
+			scene.update_world_transforms();
+		});
+
+		TransformArray array;
+		array.set(scene);
+		bench("TransformArray::update_world", 20, [&](){
+			array.update_world();
+		});
+	}
+
+	{ //threaded world transform updates on a much larger array:
+		uint32_t big_count = 1000000;
+		if (argc > 2) big_count = uint32_t(std::stoul(argv[2]));
+
+		TransformArray array;
+		std::mt19937 mt(0x15466);
+		for (uint32_t i = 0; i < big_count; ++i) {
+			TransformArray::Handle parent;
+			if (i > 0 && mt() % 16 != 0) parent.index = mt() % i;
+			array.add(parent, "", glm::vec3(float(mt() % 100), float(mt() % 100), float(mt() % 100)) * 0.1f);
+		}
+		array.update_levels();
+		std::cout << "TransformArray with " << array.size() << " transforms in " << (array.level_starts.size() - 1) << " levels:" << std::endl;
+
+		for (uint32_t threads : thread_counts()) {
+			bench("TransformArray::update_world(" + std::to_string(threads) + ")", 10, [&](){
+				array.update_world(threads);
+			});
+		}
+	}
+
+	{ //clustered light assignment:
+		uint32_t light_count = 1000;
+		if (argc > 3) light_count = uint32_t(std::stoul(argv[3]));
+
+		//a scene full of lights: point and spot lights scattered over a 200m x 200m area, plus a sun:
+		Scene scene;
+		std::mt19937 mt(0x15466);
+		auto unit = [&mt]() { return float(mt()) / float(mt.max()); };
+		for (uint32_t i = 0; i < light_count; ++i) {
+			scene.transforms.emplace_back();
+			Scene::Transform *t = &scene.transforms.back();
+			t->position = glm::vec3(200.0f * unit() - 100.0f, 200.0f * unit() - 100.0f, 10.0f * unit());
+			scene.lights.emplace_back(t);
+			Scene::Light &light = scene.lights.back();
+			light.type = (i == 0 ? Scene::Light::Directional : (mt() % 4 == 0 ? Scene::Light::Spot : Scene::Light::Point));
+			light.energy = glm::vec3(unit(), unit(), unit()) * 10.0f;
+			light.distance = (i == 0 ? 0.0f : 2.0f + 10.0f * unit());
+		}
+		scene.update_world_transforms();
+
+		//light spheres, as Scene::draw builds them:
+		std::vector< glm::vec4 > spheres;
+		for (auto const &light : scene.lights) {
+			bool local = (light.type == Scene::Light::Point || light.type == Scene::Light::Spot) && light.distance > 0.0f;
+			spheres.emplace_back(light.transform->world_from_local()[3], local ? light.distance : std::numeric_limits< float >::infinity());
+		}
+
+		//camera near the ground, looking across the area:
+		scene.transforms.emplace_back();
+		Scene::Transform *camera_transform = &scene.transforms.back();
+		camera_transform->position = glm::vec3(0.0f, -100.0f, 2.0f);
+		camera_transform->rotation = glm::angleAxis(glm::radians(85.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+		scene.cameras.emplace_back(camera_transform);
+		Scene::Camera &camera = scene.cameras.back();
+		camera.aspect = 16.0f / 9.0f;
+		camera_transform->update_world_cache();
+		glm::mat4 clip_from_world = camera.make_projection() * glm::mat4(camera_transform->local_from_world());
+
+		LightClusters clusters;
+		clusters.build(clip_from_world, spheres);
+		uint32_t max_lights = 0;
+		for (auto const &cell : clusters.cells) max_lights = std::max(max_lights, cell.y);
+		std::cout << "LightClusters with " << spheres.size() << " lights in " << clusters.cells.size() << " cells ("
+			<< float(clusters.indices.size() - clusters.global_count) / clusters.cells.size() << " lights per cell on average, "
+			<< max_lights << " max):" << std::endl;
+
+		for (uint32_t threads : thread_counts()) {
+			bench("LightClusters::build(" + std::to_string(threads) + ")", 20, [&](){
+				clusters.build(clip_from_world, spheres, threads);
+			});
+		}
+	}
+
+	{ //resampling (the mixer's per-block cost for voices playing at rates other than 1.0):
+		constexpr uint32_t Voices = 128;
+		constexpr uint32_t Frames = 1024; //(Sound's mix blocks are about this size)
+		std::mt19937 mt(0x28);
+		std::vector< float > data(48000);
+		for (float &d : data) d = float(mt() % 2001) / 1000.0f - 1.0f;
+		std::vector< float > out(Frames);
+
+		std::cout << "Resample::read with " << Voices << " voices x " << Frames << " frames (a block plays for "
+			<< 1000.0f * Frames / 48000.0f << " ms):" << std::endl;
+		for (auto [quality, name] : {
+			std::make_pair(Resample::Linear, "Linear"),
+			std::make_pair(Resample::Cubic, "Cubic"),
+			std::make_pair(Resample::Sinc, "Sinc") }) {
+			for (float rate : {0.75f, Resample::MaxRate}) {
+				bench(std::string("Resample::read(") + name + ", rate " + std::to_string(rate).substr(0, 4) + ")", 20, [&](){
+					for (uint32_t v = 0; v < Voices; ++v) {
+						uint32_t i = v * 373; //(voices start at different positions)
+						float frac = 0.0f;
+						Resample::read(data, true, &i, &frac, rate, 0.0f, quality, out.data(), Frames);
+					}
+				});
+			}
+		}
+	}
+
+	return 0;
+}
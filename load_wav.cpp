@@ -1,4 +1,5 @@
 #include "load_wav.hpp"
+#include "resample.hpp"
 
 #include <SDL3/SDL.h>
 
@@ -19,11 +20,12 @@ void load_wav(std::string const &filename, std::vector< float > *data_) {
 	if (!SDL_LoadWAV(filename.c_str(), &audio_spec, &audio_buf, &audio_len)) {
 		throw std::runtime_error("Failed to load WAV file '" + filename + "'; SDL says \"" + std::string(SDL_GetError()) + "\"");
 	}
-	SDL_AudioSpec out_spec{ .format=SDL_AUDIO_F32, .channels=1, .freq=AUDIO_RATE };
-	if (audio_spec.format != out_spec.format || audio_spec.channels != out_spec.channels || audio_spec.freq != out_spec.freq) {
+	//SDL handles format and channel conversion; rate conversion is done below with the (higher-quality) Resample code:
+	SDL_AudioSpec out_spec{ .format=SDL_AUDIO_F32, .channels=1, .freq=audio_spec.freq };
+	if (audio_spec.format != out_spec.format || audio_spec.channels != out_spec.channels) {
 		Uint8 *out_buf = NULL;
 		int out_len = 0;
-		std::cout << "WAV file '" + filename + "' didn't load as " + std::to_string(AUDIO_RATE) + " Hz, float32, mono; converting." << std::endl;
+		std::cout << "WAV file '" + filename + "' didn't load as float32, mono; converting." << std::endl;
 
 		if (!SDL_ConvertAudioSamples(&audio_spec, audio_buf, audio_len, &out_spec, &out_buf, &out_len)) {
 			//shouldn't happen, but if it does treat as fatal
@@ -44,6 +46,13 @@ void load_wav(std::string const &filename, std::vector< float > *data_) {
 	SDL_free(audio_buf);
 	audio_buf = NULL;
 
+	if (audio_spec.freq != int(AUDIO_RATE)) {
+		std::cout << "WAV file '" + filename + "' is " + std::to_string(audio_spec.freq) + " Hz, not " + std::to_string(AUDIO_RATE) + " Hz; resampling." << std::endl;
+		std::vector< float > converted;
+		Resample::convert(data, float(audio_spec.freq), float(AUDIO_RATE), &converted);
+		data = std::move(converted);
+	}
+
 	/* DEBUG: give audio range info:
 	float min = 0.0f;
 	float max = 0.0f;
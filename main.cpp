@@ -192,6 +192,9 @@ int main(int argc, char **argv) {
 
 		//Wait until the recently-drawn frame is shown before doing it all again:
 		SDL_GL_SwapWindow(Mode::window);
+
+		//Use a bit of spare time to load any deferred (LoadLazyPrefetch) resources:
+		call_prefetch_functions(0.002f);
 	}
 
 
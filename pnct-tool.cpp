@@ -0,0 +1,336 @@
+#include "read_write_chunk.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//Offline processing for .pnct mesh files (as written by scenes/export-meshes.py):
+// run as: ./pnct-tool [--lods N] <in.pnct> <out.pnct>
+// - copies every chunk through unchanged, except:
+// - (re)computes the 'bnd1' bounds/metadata chunk (and drops any older 'bnd0' chunk),
+//   so files written by older exporters load without a per-vertex bounds scan
+// - with --lods N, (re)builds up to N simplified levels of detail for each mesh:
+//   their vertices are appended to the 'pnct' chunk and their ranges are stored in a 'lod0' chunk
+
+//chunk layouts (must match MeshBuffer::MeshBuffer in Mesh.cpp):
+struct Vertex {
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::u8vec4 Color;
+	glm::vec2 TexCoord;
+};
+static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
+
+struct IndexEntry {
+	uint32_t name_begin, name_end;
+	uint32_t vertex_begin, vertex_end;
+};
+static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
+
+struct BoundsEntry {
+	glm::vec3 min, max;
+	glm::vec3 center;
+	float radius;
+	uint32_t vertex_count;
+	uint32_t material_begin, material_end; //material name, in the 'str0' chunk
+};
+static_assert(sizeof(BoundsEntry) == 52, "Bounds entry should be packed");
+
+struct LODEntry {
+	uint32_t mesh; //index entry this is a level of detail for
+	uint32_t vertex_begin, vertex_end; //(always unindexed)
+	float max_screen_size; //use this level when the mesh's bounding sphere covers at most this fraction of the screen height
+};
+static_assert(sizeof(LODEntry) == 16, "LOD entry should be packed");
+
+struct IndexRange {
+	uint32_t index_begin, index_end;
+};
+static_assert(sizeof(IndexRange) == 8, "Index range should be packed");
+
+struct Chunk {
+	std::string magic;
+	std::vector< char > data;
+};
+
+//read a whole chunk file into a list of chunks:
+static std::vector< Chunk > read_chunks(std::string const &filename) {
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) throw std::runtime_error("Failed to open '" + filename + "'.");
+	std::vector< Chunk > chunks;
+	while (file.peek() != EOF) {
+		char header[8];
+		if (!file.read(header, 8)) throw std::runtime_error("Truncated chunk header in '" + filename + "'.");
+		chunks.emplace_back();
+		chunks.back().magic = std::string(header, 4);
+		uint32_t size;
+		std::memcpy(&size, header + 4, 4);
+		chunks.back().data.resize(size);
+		if (!file.read(chunks.back().data.data(), size)) throw std::runtime_error("Truncated chunk '" + chunks.back().magic + "' in '" + filename + "'.");
+	}
+	return chunks;
+}
+
+template< typename T >
+static std::vector< T > as_table(Chunk const &chunk) {
+	if (chunk.data.size() % sizeof(T) != 0) {
+		throw std::runtime_error("Size of chunk '" + chunk.magic + "' not divisible by element size");
+	}
+	std::vector< T > ret(chunk.data.size() / sizeof(T));
+	if (!ret.empty()) std::memcpy(ret.data(), chunk.data.data(), chunk.data.size());
+	return ret;
+}
+
+//bounding sphere via Ritter's algorithm (start from a far-apart pair of points, grow to contain stragglers);
+// the box's circumsphere is used instead if it happens to be smaller:
+static void bounding_sphere(Vertex const *begin, Vertex const *end, glm::vec3 const &min, glm::vec3 const &max, glm::vec3 *center_, float *radius_) {
+	glm::vec3 &center = *center_;
+	float &radius = *radius_;
+	if (begin == end) {
+		center = glm::vec3(0.0f);
+		radius = -1.0f; //(empty)
+		return;
+	}
+
+	auto farthest = [&](glm::vec3 const &from) {
+		Vertex const *best = begin;
+		float best_dis2 = -1.0f;
+		for (Vertex const *v = begin; v != end; ++v) {
+			glm::vec3 d = v->Position - from;
+			float dis2 = glm::dot(d, d);
+			if (dis2 > best_dis2) {
+				best = v;
+				best_dis2 = dis2;
+			}
+		}
+		return best->Position;
+	};
+	glm::vec3 a = farthest(begin->Position);
+	glm::vec3 b = farthest(a);
+	center = 0.5f * (a + b);
+	radius = 0.5f * glm::length(b - a);
+	for (Vertex const *v = begin; v != end; ++v) {
+		float dis = glm::length(v->Position - center);
+		if (dis > radius) {
+			//grow the sphere just enough to touch v, keeping the opposite side fixed:
+			float grown = 0.5f * (radius + dis);
+			center += (v->Position - center) * ((grown - radius) / dis);
+			radius = grown;
+		}
+	}
+
+	glm::vec3 box_center = 0.5f * (min + max);
+	float box_radius = 0.0f;
+	for (Vertex const *v = begin; v != end; ++v) {
+		box_radius = std::max(box_radius, glm::length(v->Position - box_center));
+	}
+	if (box_radius < radius) {
+		center = box_center;
+		radius = box_radius;
+	}
+}
+
+//A level of detail is made by vertex clustering: positions are snapped to the average position of their cell in a grid
+// and triangles that collapse are dropped. Other attributes stay with their corners, so hard edges and seams survive.
+// (error tolerance for picking switch distances: about two pixels at 1080p)
+static float const ErrorTolerance = 1.0f / 540.0f;
+
+static std::vector< Vertex > simplify(std::vector< Vertex > const &corners, glm::vec3 const &min, glm::vec3 const &max, uint32_t resolution, float *error) {
+	float cell = std::max(std::max(max.x - min.x, max.y - min.y), max.z - min.z) / float(resolution);
+	*error = cell * std::sqrt(3.0f);
+	if (!(cell > 0.0f)) return corners;
+
+	auto cell_of = [&](glm::vec3 const &p) -> uint64_t {
+		glm::vec3 c = glm::floor((p - min) / cell);
+		uint64_t x = uint64_t(std::clamp(c.x, 0.0f, float(resolution - 1)));
+		uint64_t y = uint64_t(std::clamp(c.y, 0.0f, float(resolution - 1)));
+		uint64_t z = uint64_t(std::clamp(c.z, 0.0f, float(resolution - 1)));
+		return (z * resolution + y) * resolution + x;
+	};
+
+	//average position of each occupied cell:
+	std::unordered_map< uint64_t, std::pair< glm::vec3, uint32_t > > cells;
+	for (auto const &v : corners) {
+		auto &avg = cells.try_emplace(cell_of(v.Position), glm::vec3(0.0f), 0).first->second;
+		avg.first += v.Position;
+		avg.second += 1;
+	}
+
+	std::vector< Vertex > ret;
+	for (size_t t = 0; t + 2 < corners.size(); t += 3) {
+		uint64_t a = cell_of(corners[t].Position), b = cell_of(corners[t+1].Position), c = cell_of(corners[t+2].Position);
+		if (a == b || b == c || c == a) continue;
+		for (uint64_t i : {a, b, c}) {
+			Vertex v = corners[t + (i == a ? 0 : i == b ? 1 : 2)];
+			auto const &avg = cells[i];
+			v.Position = avg.first / float(avg.second);
+			ret.emplace_back(v);
+		}
+	}
+	return ret;
+}
+
+int main(int argc, char **argv) {
+	uint32_t lods = 0;
+	std::vector< std::string > args;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--lods" && i + 1 < argc) {
+			lods = uint32_t(std::stoul(argv[++i]));
+		} else {
+			args.emplace_back(arg);
+		}
+	}
+	if (args.size() != 2) {
+		std::cerr << "Usage:\n\t" << argv[0] << " [--lods N] <in.pnct> <out.pnct>\n(Re)computes the bounds chunk of a mesh file, and (optionally) up to N levels of detail per mesh." << std::endl;
+		return 1;
+	}
+
+	try {
+		std::vector< Chunk > chunks = read_chunks(args[0]);
+		if (chunks.size() < 3 || chunks[0].magic != "pnct" || chunks[1].magic != "str0" || chunks[2].magic != "idx0") {
+			throw std::runtime_error("Expected 'pnct', 'str0', and 'idx0' chunks at start of '" + args[0] + "'.");
+		}
+		std::vector< Vertex > vertices = as_table< Vertex >(chunks[0]);
+		std::vector< IndexEntry > index = as_table< IndexEntry >(chunks[2]);
+
+		//(indexed files store triangles in the index chunks)
+		std::vector< IndexRange > ranges;
+		std::vector< uint32_t > indices;
+		for (auto const &chunk : chunks) {
+			if (chunk.magic == "ind0") ranges = as_table< IndexRange >(chunk);
+			if (chunk.magic == "ix16") for (uint16_t i : as_table< uint16_t >(chunk)) indices.emplace_back(i);
+			if (chunk.magic == "ix32") indices = as_table< uint32_t >(chunk);
+		}
+		if (!ranges.empty() && ranges.size() != index.size()) {
+			throw std::runtime_error("index range chunk doesn't match index chunk");
+		}
+
+		//levels of detail from a previous run sit after every mesh's vertices; drop them before building new ones:
+		// (without --lods, existing levels are kept as-is)
+		uint32_t mesh_vertices = 0;
+		for (auto const &entry : index) mesh_vertices = std::max(mesh_vertices, entry.vertex_end);
+		for (auto const &chunk : chunks) {
+			if (chunk.magic != "lod0" || lods == 0) continue;
+			for (auto const &lod : as_table< LODEntry >(chunk)) {
+				if (lod.vertex_begin < mesh_vertices) throw std::runtime_error("existing level of detail overlaps mesh vertices");
+			}
+			if (mesh_vertices < vertices.size()) vertices.resize(mesh_vertices);
+		}
+
+		//keep any material hints from an existing bounds chunk:
+		std::vector< BoundsEntry > old_bounds;
+		for (auto const &chunk : chunks) {
+			if (chunk.magic == "bnd1") old_bounds = as_table< BoundsEntry >(chunk);
+		}
+		if (!old_bounds.empty() && old_bounds.size() != index.size()) {
+			std::cerr << "WARNING: existing bounds chunk doesn't match index; dropping material hints." << std::endl;
+			old_bounds.clear();
+		}
+
+		std::vector< BoundsEntry > bounds;
+		bounds.reserve(index.size());
+		for (auto const &entry : index) {
+			if (!(entry.vertex_begin <= entry.vertex_end && entry.vertex_end <= vertices.size())) {
+				throw std::runtime_error("index entry has out-of-range vertex start/count");
+			}
+			BoundsEntry b;
+			b.min = glm::vec3( std::numeric_limits< float >::infinity());
+			b.max = glm::vec3(-std::numeric_limits< float >::infinity());
+			for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) {
+				b.min = glm::min(b.min, vertices[v].Position);
+				b.max = glm::max(b.max, vertices[v].Position);
+			}
+			bounding_sphere(vertices.data() + entry.vertex_begin, vertices.data() + entry.vertex_end, b.min, b.max, &b.center, &b.radius);
+			b.vertex_count = entry.vertex_end - entry.vertex_begin;
+			b.material_begin = b.material_end = 0;
+			if (!old_bounds.empty()) {
+				b.material_begin = old_bounds[bounds.size()].material_begin;
+				b.material_end = old_bounds[bounds.size()].material_end;
+			}
+			bounds.emplace_back(b);
+		}
+
+		std::vector< LODEntry > lod_entries;
+		size_t triangles = 0, lod_triangles = 0;
+		for (uint32_t e = 0; e < index.size() && lods > 0; ++e) {
+			IndexEntry const &entry = index[e];
+			BoundsEntry const &b = bounds[e];
+			if (entry.vertex_begin == entry.vertex_end) continue;
+
+			//gather the mesh's triangles as a list of corners:
+			std::vector< Vertex > corners;
+			if (!ranges.empty()) {
+				if (!(ranges[e].index_begin <= ranges[e].index_end && ranges[e].index_end <= indices.size())) {
+					throw std::runtime_error("index range has out-of-range index begin/end");
+				}
+				for (uint32_t i = ranges[e].index_begin; i < ranges[e].index_end; ++i) {
+					if (indices[i] >= entry.vertex_end - entry.vertex_begin) throw std::runtime_error("index refers to vertex outside mesh");
+					corners.emplace_back(vertices[entry.vertex_begin + indices[i]]);
+				}
+			} else {
+				corners.assign(vertices.begin() + entry.vertex_begin, vertices.begin() + entry.vertex_end);
+			}
+			triangles += corners.size() / 3;
+
+			//halve the grid resolution for each level, keeping levels that drop at least a quarter of the triangles:
+			size_t previous = corners.size();
+			uint32_t resolution = 64;
+			for (uint32_t level = 0; level < lods && resolution >= 2; resolution /= 2) {
+				float error = 0.0f;
+				std::vector< Vertex > simplified = simplify(corners, b.min, b.max, resolution, &error);
+				if (simplified.empty()) break;
+				if (simplified.size() * 4 > previous * 3) continue;
+
+				LODEntry lod;
+				lod.mesh = e;
+				lod.vertex_begin = uint32_t(vertices.size());
+				vertices.insert(vertices.end(), simplified.begin(), simplified.end());
+				lod.vertex_end = uint32_t(vertices.size());
+				//projected error is at most ErrorTolerance (of screen height) while the sphere's projected diameter is at most:
+				lod.max_screen_size = ErrorTolerance * 2.0f * b.radius / error;
+				lod_entries.emplace_back(lod);
+
+				lod_triangles += simplified.size() / 3;
+				previous = simplified.size();
+				++level;
+			}
+		}
+
+		std::ofstream out(args[1], std::ios::binary);
+		for (auto const &chunk : chunks) {
+			if (chunk.magic == "bnd0" || chunk.magic == "bnd1") continue;
+			if (chunk.magic == "lod0" && lods > 0) continue; //(replaced below)
+			if (chunk.magic == "pnct") {
+				write_chunk("pnct", vertices, &out);
+				continue;
+			}
+			write_chunk(chunk.magic, chunk.data, &out);
+			if (chunk.magic == "idx0") {
+				write_chunk("bnd1", bounds, &out);
+				if (!lod_entries.empty()) write_chunk("lod0", lod_entries, &out);
+			}
+		}
+		if (!out) throw std::runtime_error("Failed to write '" + args[1] + "'.");
+
+		std::cout << "Wrote bounds for " << bounds.size() << " meshes";
+		if (lods > 0) {
+			std::cout << " and " << lod_entries.size() << " levels of detail (" << lod_triangles << " triangles, from " << triangles << " at full detail)";
+		}
+		std::cout << " to '" << args[1] << "'." << std::endl;
+	} catch (std::exception &e) {
+		std::cerr << "ERROR: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
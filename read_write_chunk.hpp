@@ -10,6 +10,7 @@
 // |ma|gi|c.|..| <-- four byte "magic number"
 // |sz|sz|sz|sz| <-- four byte (native endian) size
 // |TT...TT| * (sz/sizeof(TT)) <-- enough T structures to make up sz bytes
+//(to read chunks from a file in any order without copying them, see ChunkFile.hpp)
 
 template< typename T >
 void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *to_) {
@@ -0,0 +1,181 @@
+#include "resample.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+
+	//windowed-sinc filter layout:
+	constexpr uint32_t SincTaps = 16; //taps per output sample (reads data[i-7] through data[i+8])
+	constexpr uint32_t SincPhases = 128; //fractional positions stored in the table (linearly interpolated between)
+	constexpr uint32_t SincBands = 5; //cutoff frequencies, for rates 1, sqrt(2), 2, 2 sqrt(2), 4
+	static_assert(SincBands == 5 && Resample::MaxRate == 4.0f, "the top band should be for MaxRate");
+
+	struct SincTable {
+		//coef[band][phase][tap] is the weight of data[i - SincTaps/2 + 1 + tap] at frac == phase / SincPhases;
+		//delta[band][phase][tap] is the change in that weight to the next phase:
+		alignas(64) float coef[SincBands][SincPhases][SincTaps];
+		alignas(64) float delta[SincBands][SincPhases][SincTaps];
+
+		SincTable() {
+			constexpr float Pi = 3.14159265358979f;
+			constexpr float HalfWidth = SincTaps / 2;
+			for (uint32_t band = 0; band < SincBands; ++band) {
+				//cutoff a bit below nyquist (scaled by the band's maximum rate) so the transition band doesn't alias:
+				float cutoff = 0.95f * std::pow(2.0f, -0.5f * float(band));
+
+				//weights for one phase, normalized to unit DC gain:
+				auto weights = [&](float frac, float *w) {
+					float sum = 0.0f;
+					for (uint32_t t = 0; t < SincTaps; ++t) {
+						float x = float(t) - (HalfWidth - 1.0f) - frac;
+						float s = (x == 0.0f ? 1.0f : std::sin(Pi * cutoff * x) / (Pi * cutoff * x));
+						float a = x / HalfWidth; //window position in [-1,1]
+						float window = (std::abs(a) >= 1.0f ? 0.0f : 0.42f + 0.5f * std::cos(Pi * a) + 0.08f * std::cos(2.0f * Pi * a)); //Blackman
+						w[t] = s * window;
+						sum += w[t];
+					}
+					for (uint32_t t = 0; t < SincTaps; ++t) {
+						w[t] /= sum;
+					}
+				};
+
+				for (uint32_t phase = 0; phase < SincPhases; ++phase) {
+					float next[SincTaps];
+					weights(phase / float(SincPhases), coef[band][phase]);
+					weights((phase + 1) / float(SincPhases), next);
+					for (uint32_t t = 0; t < SincTaps; ++t) {
+						delta[band][phase][t] = next[t] - coef[band][phase][t];
+					}
+				}
+			}
+		}
+	};
+
+	//built at static-init time so the audio callback never pays for it:
+	SincTable const sinc_table;
+
+	//read data[j], wrapping (if looping) or zero-filling (if not) when j is out of range:
+	inline float fetch(std::vector< float > const &data, bool loop, int64_t j) {
+		int64_t size = int64_t(data.size());
+		if (j >= 0 && j < size) return data[size_t(j)];
+		if (!loop) return 0.0f;
+		j %= size;
+		if (j < 0) j += size;
+		return data[size_t(j)];
+	}
+
+	inline uint32_t sinc_band(float rate) {
+		if (rate <= 1.0f) return 0;
+		//bands are half-octaves of rate:
+		float band = std::ceil(2.0f * std::log2(rate));
+		return uint32_t(std::min(band, float(SincBands - 1)));
+	}
+
+	inline float interpolate_sinc(std::vector< float > const &data, bool loop, uint32_t i, float frac, uint32_t band) {
+		constexpr uint32_t Before = SincTaps / 2 - 1;
+
+		float const *taps;
+		float gathered[SincTaps];
+		if (i >= Before && i + (SincTaps - Before) <= data.size()) {
+			taps = data.data() + (i - Before); //common case: read in place
+		} else {
+			for (uint32_t t = 0; t < SincTaps; ++t) {
+				gathered[t] = fetch(data, loop, int64_t(i) - int64_t(Before) + int64_t(t));
+			}
+			taps = gathered;
+		}
+
+		float p = frac * SincPhases;
+		uint32_t phase = std::min(uint32_t(p), SincPhases - 1);
+		float f = p - float(phase);
+		float const *coef = sinc_table.coef[band][phase];
+		float const *delta = sinc_table.delta[band][phase];
+
+		//n.b. simple fixed-length loop so the compiler can vectorize it:
+		float acc = 0.0f;
+		for (uint32_t t = 0; t < SincTaps; ++t) {
+			acc += taps[t] * (coef[t] + f * delta[t]);
+		}
+		return acc;
+	}
+
+	inline float interpolate_cubic(std::vector< float > const &data, bool loop, uint32_t i, float frac) {
+		float y0 = fetch(data, loop, int64_t(i) - 1);
+		float y1 = fetch(data, loop, int64_t(i));
+		float y2 = fetch(data, loop, int64_t(i) + 1);
+		float y3 = fetch(data, loop, int64_t(i) + 2);
+		//Catmull-Rom:
+		float a = -0.5f * y0 + 1.5f * y1 - 1.5f * y2 + 0.5f * y3;
+		float b = y0 - 2.5f * y1 + 2.0f * y2 - 0.5f * y3;
+		float c = -0.5f * y0 + 0.5f * y2;
+		return ((a * frac + b) * frac + c) * frac + y1;
+	}
+
+	inline float interpolate_linear(std::vector< float > const &data, bool loop, uint32_t i, float frac) {
+		float y0 = fetch(data, loop, int64_t(i));
+		float y1 = fetch(data, loop, int64_t(i) + 1);
+		return y0 + (y1 - y0) * frac;
+	}
+
+}
+
+uint32_t Resample::read(std::vector< float > const &data, bool loop, uint32_t *i_, float *frac_,
+	float rate, float rate_step, Quality quality,
+	float *out, uint32_t count) {
+	assert(i_ && frac_);
+	assert(out || count == 0);
+
+	uint32_t &i = *i_;
+	float &frac = *frac_;
+	uint32_t size = uint32_t(data.size());
+	if (size == 0) return 0;
+
+	//(band is picked once per block, from the larger of the start and end rates, to keep the inner loop simple)
+	uint32_t band = sinc_band(std::max(rate, rate + rate_step * count));
+
+	uint32_t n = 0;
+	while (n < count) {
+		if (quality == Sinc) {
+			out[n] = interpolate_sinc(data, loop, i, frac, band);
+		} else if (quality == Cubic) {
+			out[n] = interpolate_cubic(data, loop, i, frac);
+		} else {
+			out[n] = interpolate_linear(data, loop, i, frac);
+		}
+		++n;
+
+		//advance position:
+		frac += std::max(0.0f, rate);
+		rate += rate_step;
+		if (frac >= 1.0f) {
+			uint32_t whole = uint32_t(frac);
+			frac -= float(whole);
+			i += whole;
+		}
+		if (i >= size) {
+			if (loop) {
+				i %= size;
+			} else {
+				break;
+			}
+		}
+	}
+
+	return n;
+}
+
+void Resample::convert(std::vector< float > const &in, float in_rate, float out_rate, std::vector< float > *out_) {
+	assert(out_);
+	auto &out = *out_;
+	assert(in_rate > 0.0f && out_rate > 0.0f);
+
+	float rate = in_rate / out_rate;
+	out.resize(size_t(std::ceil(in.size() / rate)));
+
+	uint32_t i = 0;
+	float frac = 0.0f;
+	uint32_t got = read(in, false, &i, &frac, rate, 0.0f, Sinc, out.data(), uint32_t(out.size()));
+	out.resize(got);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+//Fractional-rate playback of mono sample data.
+// Used by Sound's mixer for per-voice pitch control, and by load_wav for sample rate conversion.
+
+namespace Resample {
+
+enum Quality : uint8_t {
+	Linear, //2-tap linear interpolation (cheapest; audible aliasing/dulling)
+	Cubic, //4-tap Catmull-Rom spline (good for short effects)
+	Sinc, //16-tap windowed-sinc polyphase filter (best; band-limited for rates up to MaxRate)
+};
+
+//highest rate the Sinc filter's cutoff bands cover (Sound clamps playback rates to this):
+constexpr float MaxRate = 4.0f;
+
+//Read 'count' output values from 'data' starting at position (*i + *frac), advancing by 'rate' input
+// samples per output value (rate changes by 'rate_step' after each output value):
+//  - if 'loop' is set, reads wrap around the end of data; otherwise reads past the end are zero.
+//  - *i and *frac are updated to the position after the last value read.
+//  - returns the number of values written to out; this is less than 'count' only if !loop and the data ran out
+//    (in which case *i will be >= data.size()).
+uint32_t read(std::vector< float > const &data, bool loop, uint32_t *i, float *frac,
+	float rate, float rate_step, Quality quality,
+	float *out, uint32_t count);
+
+//Convert a whole buffer from 'in_rate' to 'out_rate' samples per second (using Sinc quality):
+void convert(std::vector< float > const &in, float in_rate, float out_rate, std::vector< float > *out);
+
+} //namespace Resample
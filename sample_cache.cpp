@@ -0,0 +1,132 @@
+#include "sample_cache.hpp"
+
+#include "read_write_chunk.hpp"
+#include "data_path.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+
+//version of the decoding pipeline (load_wav + load_opus); change to invalidate old cache entries:
+constexpr uint32_t SAMPLE_CACHE_VERSION = 2; //2: load_wav resamples with Resample::convert
+
+constexpr uint32_t AUDIO_RATE = 48000;
+
+//stored at the start of every cache file so stale/colliding entries can be detected:
+struct SampleCacheHeader {
+	uint64_t source_hash;
+	uint32_t version;
+	uint32_t rate;
+};
+static_assert(sizeof(SampleCacheHeader) == 8 + 4 + 4, "SampleCacheHeader is packed.");
+
+//64-bit FNV-1a hash of a file's contents; returns 'false' if the file can't be read:
+static bool hash_file(std::string const &filename, uint64_t *hash_) {
+	assert(hash_);
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) return false;
+
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	std::vector< char > buffer(1 << 16);
+	while (file) {
+		file.read(buffer.data(), buffer.size());
+		std::streamsize got = file.gcount();
+		for (std::streamsize i = 0; i < got; ++i) {
+			hash = (hash ^ uint8_t(buffer[i])) * 0x100000001b3ULL;
+		}
+	}
+	if (!file.eof()) return false;
+
+	*hash_ = hash;
+	return true;
+}
+
+//the hash is needed both to name the cache file and to check the header, so it's also encoded in the name:
+static bool parse_hash(std::string const &cache_path, uint64_t *hash) {
+	std::string stem = std::filesystem::path(cache_path).stem().string();
+	if (stem.size() < 16) return false;
+	try {
+		*hash = std::stoull(stem.substr(0, 16), nullptr, 16);
+	} catch (std::exception &) {
+		return false;
+	}
+	return true;
+}
+
+std::string sample_cache_path(std::string const &filename) {
+	uint64_t hash = 0;
+	if (!hash_file(filename, &hash)) return "";
+
+	char name[64];
+	std::snprintf(name, sizeof(name), "%016llx-v%u.pcm", (unsigned long long)hash, (unsigned)SAMPLE_CACHE_VERSION);
+	return data_path(std::string("sample-cache/") + name);
+}
+
+bool load_sample_cache(std::string const &cache_path, std::vector< float > *data_) {
+	assert(data_);
+	auto &data = *data_;
+	data.clear();
+
+	uint64_t expected_hash = 0;
+	if (!parse_hash(cache_path, &expected_hash)) return false;
+
+	std::ifstream file(cache_path, std::ios::binary);
+	if (!file) return false; //(not yet cached -- the common case on a cold start)
+
+	try {
+		std::vector< SampleCacheHeader > header;
+		read_chunk(file, "scv0", &header);
+		if (header.size() != 1
+		 || header[0].source_hash != expected_hash
+		 || header[0].version != SAMPLE_CACHE_VERSION
+		 || header[0].rate != AUDIO_RATE) {
+			std::cerr << "WARNING: ignoring mismatched sample cache file '" << cache_path << "'." << std::endl;
+			return false;
+		}
+		read_chunk(file, "f32m", &data);
+	} catch (std::exception &e) {
+		std::cerr << "WARNING: ignoring unreadable sample cache file '" << cache_path << "': " << e.what() << std::endl;
+		data.clear();
+		return false;
+	}
+
+	return true;
+}
+
+void save_sample_cache(std::string const &cache_path, std::vector< float > const &data) {
+	uint64_t hash = 0;
+	if (!parse_hash(cache_path, &hash)) return;
+
+	std::error_code ec;
+	std::filesystem::create_directories(std::filesystem::path(cache_path).parent_path(), ec);
+	if (ec) {
+		std::cerr << "WARNING: failed to create sample cache directory (" << ec.message() << "); not caching." << std::endl;
+		return;
+	}
+
+	//write to a temporary file and then rename, so a partially-written entry never looks valid:
+	std::string temp_path = cache_path + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios::binary);
+		std::vector< SampleCacheHeader > header(1);
+		header[0].source_hash = hash;
+		header[0].version = SAMPLE_CACHE_VERSION;
+		header[0].rate = AUDIO_RATE;
+		write_chunk("scv0", header, &file);
+		write_chunk("f32m", data, &file);
+		if (!file) {
+			std::cerr << "WARNING: failed to write sample cache file '" << temp_path << "'; not caching." << std::endl;
+			file.close();
+			std::filesystem::remove(temp_path, ec);
+			return;
+		}
+	}
+	std::filesystem::rename(temp_path, cache_path, ec);
+	if (ec) {
+		std::cerr << "WARNING: failed to move sample cache file into place (" << ec.message() << ")." << std::endl;
+		std::filesystem::remove(temp_path, ec);
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+//On-disk cache of decoded audio, so that Sound::Sample doesn't need to re-decode (and re-convert) files every launch.
+// Cache entries hold 48kHz floating-point mono data, and are keyed by a hash of the source file's contents
+// and by SAMPLE_CACHE_VERSION (bump this if decoding/conversion changes!).
+
+//Figure out the cache file path for a given source file; returns "" if the source file can't be read:
+std::string sample_cache_path(std::string const &filename);
+
+//Read cached data; returns 'false' (and leaves data empty) if the cache entry is missing or invalid:
+bool load_sample_cache(std::string const &cache_path, std::vector< float > *data);
+
+//Write data to the cache; failures print a warning but are otherwise ignored:
+void save_sample_cache(std::string const &cache_path, std::vector< float > const &data);
@@ -3,6 +3,8 @@
 #based on 'export-sprites.py' and 'glsprite.py' from TCHOW Rainbow; code used is released into the public domain.
 #Patched for 15-466-f19 to remove non-pnct formats!
 #Patched for 15-466-f20 to merge data all at once (slightly faster)
+#Patched to optionally write indexed meshes (deduplicated vertices + vertex-cache-ordered indices)
+#Patched to write precomputed mesh bounds and metadata ('bnd1' chunk)
 
 #Note: Script meant to be executed within blender 4.2.1, as per:
 #blender --background --python export-meshes.py -- [...see below...]
@@ -14,8 +16,13 @@ for i in range(0,len(sys.argv)):
 	if sys.argv[i] == '--':
 		args = sys.argv[i+1:]
 
+indexed = False
+if '--indexed' in args:
+	indexed = True
+	args.remove('--indexed')
+
 if len(args) != 2:
-	print("\n\nUsage:\nblender --background --python export-meshes.py -- <infile.blend[:collection]> <outfile.pnct>\nExports the meshes referenced by all objects in the specified collection(s) (default: all objects) to a binary blob.\n")
+	print("\n\nUsage:\nblender --background --python export-meshes.py -- [--indexed] <infile.blend[:collection]> <outfile.pnct>\nExports the meshes referenced by all objects in the specified collection(s) (default: all objects) to a binary blob.\n --indexed: merge identical vertices and write index chunks ('ind0' + 'ix16' or 'ix32') after the index.\n")
 	exit(1)
 
 import bpy
@@ -38,6 +45,93 @@ else:
 print(" of '" + infile + "' to '" + outfile + "'.")
 
 import struct
+import math
+
+#Bounding sphere via Ritter's algorithm (start from a far-apart pair of points, grow to contain stragglers);
+# the box's circumsphere is used instead if it happens to be smaller.
+def bounding_sphere(points, lo, hi):
+	if len(points) == 0:
+		return ((0.0, 0.0, 0.0), -1.0)
+	def farthest(frm):
+		return max(points, key=lambda p: math.dist(p, frm))
+	a = farthest(points[0])
+	b = farthest(a)
+	center = [0.5 * (x + y) for x, y in zip(a, b)]
+	radius = 0.5 * math.dist(a, b)
+	for p in points:
+		dis = math.dist(p, center)
+		if dis > radius:
+			grown = 0.5 * (radius + dis)
+			center = [c + (x - c) * ((grown - radius) / dis) for c, x in zip(center, p)]
+			radius = grown
+	box_center = [0.5 * (x + y) for x, y in zip(lo, hi)]
+	box_radius = max(math.dist(p, box_center) for p in points)
+	if box_radius < radius:
+		return (box_center, box_radius)
+	return (center, radius)
+
+#Reorder triangles to make good use of the GPU's post-transform vertex cache.
+#This is Tom Forsyth's "Linear-Speed Vertex Cache Optimisation":
+# greedily emit the triangle whose vertices score best, where vertices score
+# higher for being recently used and for having few triangles left.
+def optimize_vertex_cache(indices, vertex_count, cache_size=32):
+	tri_count = len(indices) // 3
+	vertex_tris = [[] for _ in range(vertex_count)]
+	for t in range(tri_count):
+		for v in indices[3*t:3*t+3]:
+			vertex_tris[v].append(t)
+	cache_pos = [-1] * vertex_count
+
+	def vertex_score(v):
+		if len(vertex_tris[v]) == 0:
+			return -1.0
+		score = 0.0
+		p = cache_pos[v]
+		if p >= 0:
+			if p < 3:
+				score = 0.75 #(just-used vertices are penalized a bit so strips don't double back)
+			else:
+				score = (1.0 - (p - 3) / (cache_size - 3)) ** 1.5
+		return score + 2.0 * len(vertex_tris[v]) ** -0.5
+
+	scores = [vertex_score(v) for v in range(vertex_count)]
+	emitted = [False] * tri_count
+	cache = []
+	out = []
+	best = -1
+	scan = 0 #all triangles before 'scan' have been emitted
+	for _ in range(tri_count):
+		if best < 0:
+			#nothing in the cache is useful, so start again from the next unused triangle:
+			while emitted[scan]:
+				scan += 1
+			best = scan
+		emitted[best] = True
+		tri = indices[3*best:3*best+3]
+		out.extend(tri)
+		for v in tri:
+			vertex_tris[v].remove(best)
+
+		#move the triangle's vertices to the front of the cache:
+		cache = tri + [v for v in cache if v not in tri]
+		for v in cache[cache_size:]:
+			cache_pos[v] = -1
+			scores[v] = vertex_score(v)
+		cache = cache[:cache_size]
+		for p, v in enumerate(cache):
+			cache_pos[v] = p
+			scores[v] = vertex_score(v)
+
+		#next triangle is the best-scoring one that uses a cached vertex:
+		best = -1
+		best_score = -1.0
+		for v in cache:
+			for t in vertex_tris[v]:
+				s = scores[indices[3*t]] + scores[indices[3*t+1]] + scores[indices[3*t+2]]
+				if s > best_score:
+					best = t
+					best_score = s
+	return out
 
 bpy.ops.wm.open_mainfile(filepath=infile)
 
@@ -97,6 +191,15 @@ strings = b''
 #index gives offsets into the data (and names) for each mesh:
 index = b''
 
+#bounds gives the bounding box, bounding sphere, vertex count, and material name of each mesh
+# (so MeshBuffer doesn't have to compute bounds at load time):
+bounds = b''
+
+#(when indexed) ranges gives offsets into indices for each mesh, and indices are relative to each mesh's first vertex:
+ranges = b''
+indices = []
+max_mesh_vertices = 0
+
 vertex_count = 0
 for obj in bpy.data.objects:
 	if obj.data in to_write:
@@ -156,7 +259,7 @@ for obj in bpy.data.objects:
 		if len(obj.data.uv_layers) != 1:
 			print("WARNING: object '" + name + "' has multiple texture coordinate layers; only exporting '" + obj.data.uv_layers.active.name + "'")
 
-	local_data = b''
+	corners = []
 
 	#write the mesh triangles:
 	for poly in mesh.polygons:
@@ -165,10 +268,11 @@ for obj in bpy.data.objects:
 			assert(mesh.loops[poly.loop_indices[i]].vertex_index == poly.vertices[i])
 			loop = mesh.loops[poly.loop_indices[i]]
 			vertex = mesh.vertices[loop.vertex_index]
+			corner = b''
 			for x in vertex.co:
-				local_data += struct.pack('f', x)
+				corner += struct.pack('f', x)
 			for x in loop.normal:
-				local_data += struct.pack('f', x)
+				corner += struct.pack('f', x)
 
 			col = None
 			if colors != None and colors.domain == 'POINT':
@@ -177,19 +281,66 @@ for obj in bpy.data.objects:
 				col = colors.data[poly.loop_indices[i]].color
 			else:
 				col = (1.0, 1.0, 1.0, 1.0)
-			local_data += struct.pack('BBBB', int(col[0] * 255), int(col[1] * 255), int(col[2] * 255), 255)
+			corner += struct.pack('BBBB', int(col[0] * 255), int(col[1] * 255), int(col[2] * 255), 255)
 
 			if uvs != None:
 				uv = uvs[poly.loop_indices[i]].uv
-				local_data += struct.pack('ff', uv.x, uv.y)
+				corner += struct.pack('ff', uv.x, uv.y)
 			else:
-				local_data += struct.pack('ff', 0, 0)
-		if len(local_data) > 1000:
-			data.append(local_data)
-			local_data = b''
-	vertex_count += len(mesh.polygons) * 3
-
-	data.append(local_data)
+				corner += struct.pack('ff', 0, 0)
+			corners.append(corner)
+
+	if indexed:
+		#merge identical vertices:
+		vertices = []
+		lookup = dict()
+		local_indices = []
+		for corner in corners:
+			if corner not in lookup:
+				lookup[corner] = len(vertices)
+				vertices.append(corner)
+			local_indices.append(lookup[corner])
+
+		local_indices = optimize_vertex_cache(local_indices, len(vertices))
+
+		#store vertices in order of first use, so vertex fetches also walk (mostly) forward through memory:
+		remap = [-1] * len(vertices)
+		order = []
+		for v in local_indices:
+			if remap[v] < 0:
+				remap[v] = len(order)
+				order.append(v)
+		corners = [vertices[v] for v in order]
+
+		ranges += struct.pack('I', len(indices)) #index_begin
+		indices.extend(remap[v] for v in local_indices)
+		ranges += struct.pack('I', len(indices)) #index_end
+		max_mesh_vertices = max(max_mesh_vertices, len(corners))
+
+		print("  " + str(len(mesh.polygons) * 3) + " corners -> " + str(len(corners)) + " vertices")
+
+	points = [struct.unpack('fff', corner[0:12]) for corner in corners]
+	lo = [float('inf')] * 3
+	hi = [float('-inf')] * 3
+	for co in points:
+		lo = [min(a, b) for a, b in zip(lo, co)]
+		hi = [max(a, b) for a, b in zip(hi, co)]
+	center, radius = bounding_sphere(points, lo, hi)
+	material = ''
+	for slot in obj.material_slots:
+		if slot.material:
+			material = slot.material.name
+			break
+	material_begin = len(strings)
+	strings += bytes(material, "utf8")
+	material_end = len(strings)
+	bounds += struct.pack('ffffff', *lo, *hi)
+	bounds += struct.pack('ffff', *center, radius)
+	bounds += struct.pack('III', len(corners), material_begin, material_end)
+
+	vertex_count += len(corners)
+
+	data.append(b''.join(corners))
 
 	index += struct.pack('I', vertex_count) #vertex_end
 
@@ -205,6 +356,8 @@ blob.write(struct.pack('4s',b'pnct')) #type
 blob.write(struct.pack('I', len(data))) #length
 blob.write(data)
 #second chunk: the strings
+# (padded to a multiple of four bytes, so the tables that follow are aligned when the file is mapped)
+strings += b'\0' * (-len(strings) % 4)
 blob.write(struct.pack('4s',b'str0')) #type
 blob.write(struct.pack('I', len(strings))) #length
 blob.write(strings)
@@ -212,7 +365,28 @@ blob.write(strings)
 blob.write(struct.pack('4s',b'idx0')) #type
 blob.write(struct.pack('I', len(index))) #length
 blob.write(index)
+#fourth chunk: the bounds
+blob.write(struct.pack('4s',b'bnd1')) #type
+blob.write(struct.pack('I', len(bounds))) #length
+blob.write(bounds)
+if indexed:
+	#fifth chunk: index ranges (one per idx0 entry)
+	blob.write(struct.pack('4s',b'ind0')) #type
+	blob.write(struct.pack('I', len(ranges))) #length
+	blob.write(ranges)
+	#sixth chunk: the indices, as 16-bit values when every mesh is small enough
+	if max_mesh_vertices <= 0x10000:
+		index_data = struct.pack(str(len(indices)) + 'H', *indices)
+		blob.write(struct.pack('4s',b'ix16')) #type
+	else:
+		index_data = struct.pack(str(len(indices)) + 'I', *indices)
+		blob.write(struct.pack('4s',b'ix32')) #type
+	blob.write(struct.pack('I', len(index_data))) #length
+	blob.write(index_data)
 wrote = blob.tell()
 blob.close()
 
-print("Wrote " + str(wrote) + " bytes [== " + str(len(data)+8) + " bytes of data + " + str(len(strings)+8) + " bytes of strings + " + str(len(index)+8) + " bytes of index] to '" + outfile + "'")
+print("Wrote " + str(wrote) + " bytes [== " + str(len(data)+8) + " bytes of data + " + str(len(strings)+8) + " bytes of strings + " + str(len(index)+8) + " bytes of index + " + str(len(bounds)+8) + " bytes of bounds", end="")
+if indexed:
+	print(" + " + str(len(ranges)+8) + " bytes of index ranges + " + str(len(index_data)+8) + " bytes of indices", end="")
+print("] to '" + outfile + "'")
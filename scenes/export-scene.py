@@ -220,7 +220,8 @@ def write_chunk(magic, data):
 	blob.write(struct.pack('I', len(data))) #length
 	blob.write(data)
 
-write_chunk(b'str0', strings_data)
+#(strings are padded to a multiple of four bytes, so the tables that follow are aligned when the file is mapped)
+write_chunk(b'str0', strings_data + b'\0' * (-len(strings_data) % 4))
 write_chunk(b'xfh0', xfh_data)
 write_chunk(b'msh0', mesh_data)
 write_chunk(b'cam0', camera_data)
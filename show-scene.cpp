@@ -110,7 +110,7 @@ int main(int argc, char **argv) {
 	if (scene_file != "") {
 		try {
 			scene = new Scene();
-			scene->load(scene_file, [&buffer,&buffer_vao](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
+			scene->load(scene_file, [&buffer,&buffer_vao](Scene &scene, Scene::Transform *transform, std::string_view mesh_name){
 				if (!buffer_vao) return;
 				Mesh const &mesh = buffer->lookup(mesh_name);
 
@@ -123,6 +123,21 @@ int main(int argc, char **argv) {
 				drawable.pipeline.type = mesh.type;
 				drawable.pipeline.start = mesh.start;
 				drawable.pipeline.count = mesh.count;
+				drawable.pipeline.index_type = mesh.index_type;
+				drawable.pipeline.index_start = mesh.index_start;
+				drawable.pipeline.index_count = mesh.index_count;
+
+				drawable.min = mesh.min;
+				drawable.max = mesh.max;
+				drawable.center = mesh.center;
+				drawable.radius = mesh.radius;
+
+				drawable.lod_count = mesh.lod_count;
+				for (uint32_t l = 0; l < mesh.lod_count; ++l) {
+					drawable.lods[l].start = mesh.lods[l].start;
+					drawable.lods[l].count = mesh.lods[l].count;
+					drawable.lods[l].max_screen_size = mesh.lods[l].max_screen_size;
+				}
 
 			});
 		} catch (std::exception &e) {